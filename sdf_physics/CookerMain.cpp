@@ -0,0 +1,129 @@
+#include "engine/shape/Shape.hpp"
+#include "engine/shape/ShapeImporter.hpp"
+#include "engine/shape/ShapePack.hpp"
+#include "util/ParallelFor.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <string>
+
+namespace {
+
+void PrintUsage(const char* program) {
+	std::cerr << "Usage: " << program << " <output.pack> [options]\n"
+		"  --image path         pgm or png mask, pixel values are materials and 0 is empty\n"
+		"  --max-shape-size N   images larger than this are split into a grid of shapes, default 1024\n"
+		"  --random N           N random shapes, seeded 0 to N-1 plus --seed\n"
+		"  --size N             width and height of the random shapes, default 64\n"
+		"  --seed N             first seed, default 0\n"
+		"  --sdf-format f32|i16|u8\n"
+		"  --sdf-layout row|brick\n"
+		"  --sdf-tiled          narrow band tiled sdfs\n"
+		"  --sdf-gradients      precomputed contact normal gradients\n";
+}
+
+}
+
+// Builds a shape pack with finished sdfs, loaded with ShapeManager::LoadShapePack.
+// Usage: sdf_physics_cooker <output.pack> [options]
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	const std::string output_path = argv[1];
+
+	std::vector<std::string> image_paths;
+	ShapeImportSettings import_settings;
+	long num_random = 0;
+	long size = 64;
+	long first_seed = 0;
+	SdfSettings sdf_settings;
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : "";
+		if (arg == "--image") {
+			image_paths.push_back(value);
+			++i;
+		} else if (arg == "--max-shape-size") {
+			import_settings.max_shape_size = static_cast<u32>(std::strtol(value, nullptr, 10));
+			++i;
+		} else if (arg == "--random") {
+			num_random = std::strtol(value, nullptr, 10);
+			++i;
+		} else if (arg == "--size") {
+			size = std::strtol(value, nullptr, 10);
+			++i;
+		} else if (arg == "--seed") {
+			first_seed = std::strtol(value, nullptr, 10);
+			++i;
+		} else if (arg == "--sdf-format") {
+			if (std::strcmp(value, "i16") == 0) {
+				sdf_settings.format = SdfFormat::Int16;
+			} else if (std::strcmp(value, "u8") == 0) {
+				sdf_settings.format = SdfFormat::UInt8;
+			} else if (std::strcmp(value, "f32") != 0) {
+				std::cerr << "ERROR: unknown sdf format " << value << ", expected f32, i16 or u8\n";
+				return 1;
+			}
+			++i;
+		} else if (arg == "--sdf-layout") {
+			if (std::strcmp(value, "brick") == 0) {
+				sdf_settings.layout = SdfLayout::Bricked;
+			} else if (std::strcmp(value, "row") != 0) {
+				std::cerr << "ERROR: unknown sdf layout " << value << ", expected row or brick\n";
+				return 1;
+			}
+			++i;
+		} else if (arg == "--sdf-tiled") {
+			sdf_settings.storage = SdfStorage::Tiled;
+		} else if (arg == "--sdf-gradients") {
+			sdf_settings.gradients = true;
+		} else {
+			std::cerr << "ERROR: unknown option " << arg << "\n";
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+	if ((num_random <= 0 && image_paths.empty()) || num_random < 0 || size <= 0) {
+		std::cerr << "ERROR: nothing to cook, give --image path or --random N with a positive --size\n";
+		return 1;
+	}
+	import_settings.sdf_settings = sdf_settings;
+
+	auto start_time = std::chrono::steady_clock::now();
+
+	// One shape per batch, the sdf construction inside each runs inline
+	std::vector<std::optional<Shape>> shapes(num_random);
+	ParallelFor(static_cast<u32>(num_random), 1, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; ++i) {
+			shapes[i].emplace(glm::uvec2(static_cast<u32>(size)), static_cast<u32>(first_seed + i), sdf_settings);
+		}
+	});
+
+	// Imported shapes come first, in the order of the images and grid cells
+	std::vector<ImportedShape> imported;
+	for (auto& path : image_paths) {
+		if (!ImportShapes(path, import_settings, imported)) {
+			return 1;
+		}
+	}
+
+	std::vector<const Shape*> pack;
+	for (auto& shape : imported) {
+		pack.push_back(&shape.shape);
+	}
+	for (auto& shape : shapes) {
+		pack.push_back(&*shape);
+	}
+	if (!WriteShapePack(output_path, pack)) {
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	std::cout << "Cooked " << pack.size() << " shapes into " << output_path << " in " << seconds << " s\n";
+	return 0;
+}
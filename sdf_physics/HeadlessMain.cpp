@@ -0,0 +1,46 @@
+#include "engine/Simulation.hpp"
+#include "util/Profiler.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+// Steps the simulation at a fixed dt as fast as possible, without a window.
+// Usage: sdf_physics_headless [num_steps] [steps_per_second] [trace.json]
+int main(int argc, char** argv) {
+	long num_steps = 1000;
+	float steps_per_second = 60.f;
+	if (argc > 1) {
+		num_steps = std::strtol(argv[1], nullptr, 10);
+	}
+	if (argc > 2) {
+		steps_per_second = std::strtof(argv[2], nullptr);
+	}
+	if (num_steps <= 0 || steps_per_second <= 0.f) {
+		std::cerr << "Usage: " << argv[0] << " [num_steps] [steps_per_second] [trace.json]\n";
+		return 1;
+	}
+	const float dt = 1.f / steps_per_second;
+
+	// Zones are only recorded when a trace is requested
+	const char* trace_path = argc > 3 ? argv[3] : nullptr;
+	Profiler::SetEnabled(trace_path != nullptr);
+
+	Simulation simulation;
+	simulation.Initialize();
+
+	auto start_time = std::chrono::steady_clock::now();
+	for (long i = 0; i < num_steps; ++i) {
+		simulation.Update(dt);
+	}
+	auto end_time = std::chrono::steady_clock::now();
+
+	double seconds = std::chrono::duration<double>(end_time - start_time).count();
+	std::cout << "Simulated " << num_steps << " steps of " << dt << " s in " << seconds << " s ("
+		<< num_steps / seconds << " steps/s, " << 1000.0 * seconds / num_steps << " ms/step)\n";
+
+	if (trace_path && !Profiler::WriteChromeTrace(trace_path)) {
+		return 1;
+	}
+	return 0;
+}
@@ -50,6 +50,8 @@ Input::Input(GLFWwindow* glfw_window) : m_glfw_window{ glfw_window } {
 	m_keybinds[ClientAction::MoveFaster] = GLFW_KEY_LEFT_SHIFT;
 
 	m_keybinds[ClientAction::DebugReloadShaders] = { GLFW_KEY_F5, InputType::Released };
+	m_keybinds[ClientAction::DebugDumpProfile] = { GLFW_KEY_F6, InputType::Released };
+	m_keybinds[ClientAction::DebugDumpShapeMemory] = { GLFW_KEY_F7, InputType::Released };
 
 	m_mousebinds[ClientAction::MainDown] = GLFW_MOUSE_BUTTON_RIGHT;
 
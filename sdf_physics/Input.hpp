@@ -18,6 +18,8 @@ enum class ClientAction : u32 {
 	MoveFaster,
 
 	DebugReloadShaders,
+	DebugDumpProfile,
+	DebugDumpShapeMemory,
 
 	MainDown,
 };
@@ -0,0 +1,74 @@
+#include "Benchmark.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+bool BenchmarkArgs::Has(const std::string& flag) const {
+	for (auto& value : values) {
+		if (value == flag) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string BenchmarkArgs::Get(const std::string& flag, const std::string& fallback) const {
+	for (size_t i = 0; i + 1 < values.size(); ++i) {
+		if (values[i] == flag) {
+			return values[i + 1];
+		}
+	}
+	return fallback;
+}
+
+long BenchmarkArgs::GetInt(const std::string& flag, long fallback) const {
+	auto value = Get(flag, "");
+	if (value.empty()) {
+		return fallback;
+	}
+	return std::strtol(value.c_str(), nullptr, 10);
+}
+
+struct BenchmarkEntry {
+	const char* name;
+	int (*run)(const BenchmarkArgs&);
+	const char* description;
+};
+
+constexpr BenchmarkEntry c_Benchmarks[] = {
+	{ "physics", &RunPhysicsBenchmark, "per-phase timings of PhysicsSystem::Update on scenarios [--steps N] [--warmup N] [--filter name|name_bodies] [--sdf-format f32|i16|u8] [--sdf-layout row|brick] [--sdf-gradients] [--broadphase grid|tree]" },
+	{ "sdf", &RunSdfBenchmark, "exact distance transform, smoothing and ShapeSdf::Create against the old scalar code, 64^2 to 4096^2 [--max-size N] [--skip-reference]" },
+	{ "sdf_edit", &RunSdfEditBenchmark, "incremental ShapeSdf::Update after brush edits, checked against a full rebuild [--max-size N] [--radius N] [--edits N] [--tiled]" },
+	{ "sdf_tiled", &RunSdfTiledBenchmark, "memory and sampling cost of tiled narrow band sdfs against dense ones [--max-size N] [--samples N]" },
+	{ "sdf_format", &RunSdfFormatBenchmark, "memory, error and sampling cost of f32, i16 and u8 sdfs on random shapes [--max-size N] [--samples N]" },
+	{ "sdf_sample", &RunSdfSampleBenchmark, "scalar ShapeSdf::GetDistanceAndGradient against the batched GetDistancesAndGradients, and contact normals from taps against a gradient field [--max-size N] [--samples N] [--batch N]" },
+	{ "shape_gen", &RunShapeGenerationBenchmark, "random shape images against the old glm::simplex generator, and whole shapes with sdfs [--max-size N] [--shapes N]" },
+	{ "shape_cook", &RunShapeCookBenchmark, "creating shapes while a pile is running, synchronously against ShapeManager::CreateShapeAsync [--shapes N] [--size N] [--steps N]" },
+	{ "shape_share", &RunShapeShareBenchmark, "instances created from a few images, a shape each against ShapeManager::CreateSharedShape [--instances N] [--images N] [--size N]" },
+	{ "shape_pack", &RunShapePackBenchmark, "creating shapes with sdfs against reading them back from a shape pack [--shapes N] [--max-size N] [--path file]" },
+	{ "shape_import", &RunShapeImportBenchmark, "streaming pgm and png import split into a grid of shapes against one sdf over the whole source [--max-size N] [--max-shape-size N] [--path file]" },
+	{ "shape_mass", &RunShapeMassBenchmark, "mass moments from the bit packed occupancy against walking the image bytes [--max-size N] [--repetitions N]" },
+	{ "broadphase", &RunBroadphaseBenchmark, "update and pair query cost of the grid and the aabb tree broadphase on moving bodies of uniform, spread and clustered sizes [--bodies N] [--steps N]" },
+};
+
+// Results are written to stdout as csv, progress and errors to stderr.
+// Usage: sdf_physics_bench <benchmark> [options]
+int main(int argc, char** argv) {
+	if (argc > 1) {
+		BenchmarkArgs args;
+		for (int i = 2; i < argc; ++i) {
+			args.values.push_back(argv[i]);
+		}
+		for (auto& benchmark : c_Benchmarks) {
+			if (benchmark.name == std::string(argv[1])) {
+				return benchmark.run(args);
+			}
+		}
+	}
+
+	std::cerr << "Usage: " << argv[0] << " <benchmark> [options]\n";
+	for (auto& benchmark : c_Benchmarks) {
+		std::cerr << "  " << benchmark.name << " - " << benchmark.description << "\n";
+	}
+	return 1;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct BenchmarkArgs {
+	std::vector<std::string> values;
+
+	bool Has(const std::string& flag) const;
+	std::string Get(const std::string& flag, const std::string& fallback) const;
+	long GetInt(const std::string& flag, long fallback) const;
+};
+
+int RunPhysicsBenchmark(const BenchmarkArgs& args);
+int RunSdfBenchmark(const BenchmarkArgs& args);
+int RunSdfEditBenchmark(const BenchmarkArgs& args);
+int RunSdfTiledBenchmark(const BenchmarkArgs& args);
+int RunSdfFormatBenchmark(const BenchmarkArgs& args);
+int RunSdfSampleBenchmark(const BenchmarkArgs& args);
+int RunShapeGenerationBenchmark(const BenchmarkArgs& args);
+int RunShapeCookBenchmark(const BenchmarkArgs& args);
+int RunShapeShareBenchmark(const BenchmarkArgs& args);
+int RunShapePackBenchmark(const BenchmarkArgs& args);
+int RunShapeImportBenchmark(const BenchmarkArgs& args);
+int RunShapeMassBenchmark(const BenchmarkArgs& args);
+int RunBroadphaseBenchmark(const BenchmarkArgs& args);
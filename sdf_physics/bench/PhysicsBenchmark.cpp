@@ -0,0 +1,566 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/noise.hpp>
+#include <glm/gtx/component_wise.hpp>
+#include <robin_hood/robin_hood.h>
+
+#include "engine/Broadphase.hpp"
+#include "engine/Simulation.hpp"
+#include "engine/Terrain.hpp"
+#include "engine/shape/ShapeManager.hpp"
+#include "engine/shape/ShapeMetadata.hpp"
+#include "ecs/components/Transform.hpp"
+#include "ecs/systems/PhysicsSystem.hpp"
+
+namespace {
+
+constexpr float c_BenchmarkDt = 1.f / 60.f;
+
+struct Scenario {
+	std::string name;
+	u32 num_bodies;
+	std::function<void(Simulation&, std::mt19937&, const SdfSettings&)> setup;
+};
+
+/// Box with a one pixel empty border so the sdf has a surface inside the image
+Shape CreateBoxShape(glm::uvec2 size, const SdfSettings& sdf_settings) {
+	std::vector<u8> image(glm::compMul(size), c_MaterialEmptySpace);
+	for (u32 y = 1; y + 1 < size.y; ++y) {
+		for (u32 x = 1; x + 1 < size.x; ++x) {
+			image[x + y * size.x] = 1;
+		}
+	}
+	return Shape(size, std::move(image), sdf_settings);
+}
+
+Shape CreateCarvedShape(glm::uvec2 size, std::mt19937& random, const SdfSettings& sdf_settings) {
+	Shape source(size);
+	auto image = source.GetImage();
+
+	std::uniform_real_distribution<float> position(0.f, static_cast<float>(size.x));
+	const float radius = size.x / 8.f;
+	for (int hole = 0; hole < 3; ++hole) {
+		glm::vec2 center(position(random), position(random));
+		for (u32 y = 0; y < size.y; ++y) {
+			for (u32 x = 0; x < size.x; ++x) {
+				glm::vec2 diff = glm::vec2(x, y) + 0.5f - center;
+				if (glm::dot(diff, diff) < radius * radius) {
+					image[x + y * size.x] = c_MaterialEmptySpace;
+				}
+			}
+		}
+	}
+	return Shape(size, std::move(image), sdf_settings);
+}
+
+void SetupBox(Simulation& simulation, float width) {
+	simulation.GetSystemManager().Get<PhysicsSystem>().SetPlanes({
+		{ glm::vec2(0, 0), glm::vec2(0, 1) },
+		{ glm::vec2(0, 0), glm::vec2(1, 0) },
+		{ glm::vec2(width, 0), glm::vec2(-1, 0) },
+	});
+}
+
+/// Bodies on a jittered grid, roughly as wide as it is tall, picking shapes from the pool
+void SetupPile(Simulation& simulation, std::mt19937& random, u32 num_bodies, const std::vector<ShapeId>& pool) {
+	auto& system_manager = simulation.GetSystemManager();
+	auto& shape_manager = system_manager.Get<ShapeManager>();
+	auto& physics = system_manager.Get<PhysicsSystem>();
+
+	float max_size = 0.f;
+	for (auto shape_id : pool) {
+		max_size = glm::max(max_size, glm::compMax(shape_manager.GetShape(shape_id)->GetSizeInMeters()));
+	}
+	const float spacing = 1.1f * max_size;
+	const u32 columns = static_cast<u32>(glm::ceil(glm::sqrt(static_cast<float>(num_bodies))));
+	SetupBox(simulation, columns * spacing);
+
+	std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+	std::uniform_real_distribution<float> rotation(0.f, glm::two_pi<float>());
+	for (u32 i = 0; i < num_bodies; ++i) {
+		glm::vec2 cell(i % columns, i / columns);
+		glm::vec2 position = spacing * (cell + 0.5f) + glm::vec2(jitter(random), jitter(random));
+		physics.CreateBody(pool[i % pool.size()], position, rotation(random));
+	}
+}
+
+std::vector<ShapeId> CreateRandomPool(Simulation& simulation, std::mt19937& random, u32 count,
+	const std::vector<u32>& sizes, const SdfSettings& sdf_settings) {
+	auto& shape_manager = simulation.GetSystemManager().Get<ShapeManager>();
+	std::vector<ShapeId> pool;
+	for (u32 i = 0; i < count; ++i) {
+		auto size = sizes[i % sizes.size()];
+		// Small random shapes can come out empty, which can not be a body
+		Shape shape(glm::uvec2(size), random(), sdf_settings);
+		while (std::find(shape.GetImage().begin(), shape.GetImage().end(), 1) == shape.GetImage().end()) {
+			shape = Shape(glm::uvec2(size), random(), sdf_settings);
+		}
+		pool.push_back(shape_manager.CreateShape(std::move(shape)).GetId());
+	}
+	return pool;
+}
+
+Scenario Pile(u32 num_bodies) {
+	return { "pile", num_bodies, [num_bodies](Simulation& simulation, std::mt19937& random, const SdfSettings& sdf_settings) {
+		SetupPile(simulation, random, num_bodies, CreateRandomPool(simulation, random, 16, { 64 }, sdf_settings));
+	}};
+}
+
+Scenario MixedPile(u32 num_bodies) {
+	return { "mixed", num_bodies, [num_bodies](Simulation& simulation, std::mt19937& random, const SdfSettings& sdf_settings) {
+		SetupPile(simulation, random, num_bodies, CreateRandomPool(simulation, random, 16, { 16, 32, 64, 128 }, sdf_settings));
+	}};
+}
+
+/// Shapes too large to stay in cache between samples
+Scenario LargePile(u32 num_bodies) {
+	return { "large", num_bodies, [num_bodies](Simulation& simulation, std::mt19937& random, const SdfSettings& sdf_settings) {
+		SetupPile(simulation, random, num_bodies, CreateRandomPool(simulation, random, 16, { 256, 512 }, sdf_settings));
+	}};
+}
+
+Scenario CarvedPile(u32 num_bodies) {
+	return { "carved", num_bodies, [num_bodies](Simulation& simulation, std::mt19937& random, const SdfSettings& sdf_settings) {
+		auto& shape_manager = simulation.GetSystemManager().Get<ShapeManager>();
+		std::vector<ShapeId> pool;
+		for (int i = 0; i < 16; ++i) {
+			pool.push_back(shape_manager.CreateShape(CreateCarvedShape(glm::uvec2(64), random, sdf_settings)).GetId());
+		}
+		SetupPile(simulation, random, num_bodies, pool);
+	}};
+}
+
+Scenario Stack(u32 num_bodies) {
+	return { "stack", num_bodies, [num_bodies](Simulation& simulation, std::mt19937&, const SdfSettings& sdf_settings) {
+		auto& system_manager = simulation.GetSystemManager();
+		auto& shape = system_manager.Get<ShapeManager>().CreateShape(CreateBoxShape(glm::uvec2(32), sdf_settings));
+		auto& physics = system_manager.Get<PhysicsSystem>();
+
+		const float size = shape.GetSizeInMeters().y;
+		SetupBox(simulation, 4.f * size);
+		for (u32 i = 0; i < num_bodies; ++i) {
+			physics.CreateBody(shape.GetId(), glm::vec2(2.f * size, (i + 0.5f) * size));
+		}
+	}};
+}
+
+Scenario Pyramid(u32 base) {
+	return { "pyramid", base * (base + 1) / 2, [base](Simulation& simulation, std::mt19937&, const SdfSettings& sdf_settings) {
+		auto& system_manager = simulation.GetSystemManager();
+		auto& shape = system_manager.Get<ShapeManager>().CreateShape(CreateBoxShape(glm::uvec2(32), sdf_settings));
+		auto& physics = system_manager.Get<PhysicsSystem>();
+
+		const float size = shape.GetSizeInMeters().y;
+		SetupBox(simulation, (base + 2) * size);
+		for (u32 row = 0; row < base; ++row) {
+			for (u32 i = 0; i < base - row; ++i) {
+				glm::vec2 position((1.5f + 0.5f * row + i) * size, (row + 0.5f) * size);
+				physics.CreateBody(shape.GetId(), position);
+			}
+		}
+	}};
+}
+
+/// Rolling hills with floating rocks, wide enough that only the tiles near the bodies are loaded
+Scenario TerrainPile(u32 num_bodies) {
+	return { "terrain", num_bodies, [num_bodies](Simulation& simulation, std::mt19937& random, const SdfSettings& sdf_settings) {
+		auto& system_manager = simulation.GetSystemManager();
+		auto& terrain = system_manager.Get<Terrain>();
+		auto& physics = system_manager.Get<PhysicsSystem>();
+
+		const glm::uvec2 level_size(16384, 1024);
+		std::vector<u8> level(glm::compMul(level_size), c_MaterialEmptySpace);
+		for (u32 x = 0; x < level_size.x; ++x) {
+			const float ground = 256.f + 128.f * glm::simplex(glm::vec2(x / 1024.f, 0.5f));
+			for (u32 y = 0; y < level_size.y; ++y) {
+				const bool rock = glm::simplex(glm::vec2(x, y) / 128.f) > 0.6f && y > ground + 128.f;
+				if (y < ground || rock) {
+					level[x + y * level_size.x] = 1;
+				}
+			}
+		}
+		TerrainSettings settings;
+		settings.sdf_settings = sdf_settings;
+		terrain.SetImage(level_size, std::move(level), settings);
+		const float width = level_size.x * c_PixelSizeMeters;
+		physics.SetPlanes({
+			{ glm::vec2(0, 0), glm::vec2(1, 0) },
+			{ glm::vec2(width, 0), glm::vec2(-1, 0) },
+		});
+
+		// A pile at each end of the level, the tiles between them stay unloaded
+		auto pool = CreateRandomPool(simulation, random, 16, { 64 }, sdf_settings);
+		std::uniform_real_distribution<float> rotation(0.f, glm::two_pi<float>());
+		std::vector<glm::vec2> positions;
+		const u32 columns = 16;
+		for (u32 i = 0; i < num_bodies; ++i) {
+			const u32 pile = i % 2;
+			const u32 index = i / 2;
+			glm::vec2 position(1.1f * (index % columns + 0.5f), 10.f + 1.1f * (index / columns));
+			position.x += pile * (width - 1.1f * columns);
+			physics.CreateBody(pool[i % pool.size()], position, rotation(random));
+			positions.push_back(position);
+		}
+		terrain.StreamAround(positions);
+		terrain.FinishLoading();
+	}};
+}
+
+/// Spawns a body once its shape is cooked, like a game would
+class CookedShapeSpawner {
+public:
+	CookedShapeSpawner(PhysicsSystem& physics, glm::vec2 position) : m_physics(physics), m_position(position) {}
+
+	void OnShapeCooked(ShapeId id) {
+		m_physics.CreateBody(id, m_position + glm::vec2(0, 0.5f * m_num_spawned++));
+	}
+
+	u32 GetNumSpawned() const {
+		return m_num_spawned;
+	}
+
+private:
+	PhysicsSystem& m_physics;
+	glm::vec2 m_position;
+	u32 m_num_spawned = 0;
+};
+
+}
+
+int RunShapeCookBenchmark(const BenchmarkArgs& args) {
+	const long num_shapes = args.GetInt("--shapes", 16);
+	const long shape_size = args.GetInt("--size", 256);
+	const long max_steps = args.GetInt("--steps", 1000);
+	if (num_shapes <= 0 || shape_size <= 0 || max_steps <= 0) {
+		std::cerr << "ERROR: invalid shape count, size or step count\n";
+		return 1;
+	}
+
+	using Clock = std::chrono::steady_clock;
+	auto elapsed_ms = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	std::cout << "mode,shapes,size,submit_ms,max_step_ms,steps_until_spawned,total_ms\n";
+	for (bool async : { false, true }) {
+		std::cerr << "Running " << (async ? "async" : "sync") << "\n";
+
+		srand(101);
+		std::mt19937 random(101);
+		Simulation simulation;
+		auto& system_manager = simulation.GetSystemManager();
+		auto& shape_manager = system_manager.Get<ShapeManager>();
+		auto& physics = system_manager.Get<PhysicsSystem>();
+		SetupPile(simulation, random, 500, CreateRandomPool(simulation, random, 16, { 64 }, {}));
+		for (int i = 0; i < 10; ++i) {
+			simulation.Update(c_BenchmarkDt);
+		}
+
+		CookedShapeSpawner spawner(physics, glm::vec2(0, 100));
+		shape_manager.OnShapeCooked().connect<&CookedShapeSpawner::OnShapeCooked>(spawner);
+
+		// Shapes streamed in while the simulation is running, synchronous creation stalls the frame
+		auto start = Clock::now();
+		for (long i = 0; i < num_shapes; ++i) {
+			const glm::uvec2 size(static_cast<u32>(shape_size));
+			const u32 seed = static_cast<u32>(i);
+			if (async) {
+				shape_manager.CreateShapeAsync([size, seed]() {
+					return Shape(size, seed);
+				});
+			} else {
+				spawner.OnShapeCooked(shape_manager.CreateShape(Shape(size, seed)).GetId());
+			}
+		}
+		const double submit_ms = elapsed_ms(start);
+
+		double max_step_ms = 0.0;
+		long steps = 0;
+		while (spawner.GetNumSpawned() < num_shapes && steps < max_steps) {
+			auto step_start = Clock::now();
+			simulation.Update(c_BenchmarkDt);
+			max_step_ms = glm::max(max_step_ms, elapsed_ms(step_start));
+			++steps;
+		}
+		if (spawner.GetNumSpawned() < num_shapes) {
+			std::cerr << "ERROR: only " << spawner.GetNumSpawned() << " of " << num_shapes << " shapes cooked in " << steps << " steps\n";
+		}
+
+		std::cout << (async ? "async" : "sync") << "," << num_shapes << "," << shape_size << ","
+			<< submit_ms << "," << max_step_ms << "," << steps << "," << elapsed_ms(start) << std::endl;
+	}
+	return 0;
+}
+
+int RunShapeShareBenchmark(const BenchmarkArgs& args) {
+	const long num_instances = args.GetInt("--instances", 20000);
+	const long num_images = args.GetInt("--images", 256);
+	const long image_size = args.GetInt("--size", 32);
+	if (num_instances <= 0 || num_images <= 0 || image_size <= 0) {
+		std::cerr << "ERROR: invalid instance count, image count or size\n";
+		return 1;
+	}
+
+	using Clock = std::chrono::steady_clock;
+	const glm::uvec2 size(static_cast<u32>(image_size));
+	std::vector<std::vector<u8>> images;
+	for (long i = 0; i < num_images; ++i) {
+		images.push_back(Shape::GenerateRandomImage(size, static_cast<u32>(i)));
+	}
+
+	std::cout << "mode,instances,images,shapes,image_bytes,sdf_bytes,create_ms\n";
+	for (bool shared : { false, true }) {
+		std::cerr << "Running " << (shared ? "shared" : "unique") << "\n";
+
+		Simulation simulation;
+		auto& shape_manager = simulation.GetSystemManager().Get<ShapeManager>();
+		std::vector<ShapeId> instances;
+		instances.reserve(num_instances);
+		robin_hood::unordered_flat_set<ShapeId> shape_ids;
+
+		// Every instance comes with its own copy of the image, like shapes loaded from a level
+		auto start = Clock::now();
+		for (long i = 0; i < num_instances; ++i) {
+			auto image = images[i % num_images];
+			if (shared) {
+				instances.push_back(shape_manager.CreateSharedShape(size, std::move(image)));
+			} else {
+				instances.push_back(shape_manager.CreateShape(Shape(size, std::move(image))).GetId());
+			}
+		}
+		const double create_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		shape_ids.insert(instances.begin(), instances.end());
+		u64 image_bytes = 0;
+		u64 sdf_bytes = 0;
+		for (auto id : shape_ids) {
+			auto* shape = shape_manager.GetShape(id);
+			image_bytes += shape->GetImage().size();
+			sdf_bytes += shape->GetSdf().GetMemoryUsage().bytes;
+		}
+
+		std::cout << (shared ? "shared" : "unique") << "," << num_instances << "," << num_images << ","
+			<< shape_ids.size() << "," << image_bytes << "," << sdf_bytes << "," << create_ms << std::endl;
+	}
+	return 0;
+}
+
+struct BroadphaseScenario {
+	std::string name;
+	/// Shape sizes in pixels and how often each is picked
+	std::vector<std::pair<u32, double>> sizes;
+	float area_per_body;
+	float moving_fraction;
+};
+
+int RunBroadphaseBenchmark(const BenchmarkArgs& args) {
+	const long num_bodies = args.GetInt("--bodies", 20000);
+	const long num_steps = args.GetInt("--steps", 100);
+	if (num_bodies <= 0 || num_steps <= 0) {
+		std::cerr << "ERROR: invalid body or step count\n";
+		return 1;
+	}
+
+	const std::vector<BroadphaseScenario> scenarios = {
+		{ "uniform", { { 64, 1.0 } }, 4.f, 1.f },
+		{ "resting", { { 64, 1.0 } }, 4.f, 0.05f },
+		// Mostly small bodies between a few that cover many grid cells
+		{ "spread", { { 8, 0.9 }, { 64, 0.09 }, { 512, 0.01 } }, 4.f, 1.f },
+		// Small bodies crowding into few grid cells
+		{ "clustered", { { 8, 1.0 } }, 0.1f, 1.f },
+	};
+
+	using Clock = std::chrono::steady_clock;
+	std::cout << "scenario,broadphase,bodies,steps,update_ms,pairs_ms,total_ms,pairs\n";
+	for (auto& scenario : scenarios) {
+		std::cerr << "Running " << scenario.name << "\n";
+
+		// Only the size of the shapes matters to the broadphase
+		std::vector<Shape> shapes;
+		std::vector<double> weights;
+		for (auto [size, weight] : scenario.sizes) {
+			shapes.emplace_back(glm::uvec2(size), std::vector<u8>(size_t(size) * size, 1));
+			weights.push_back(weight);
+		}
+
+		std::mt19937 random(101);
+		std::discrete_distribution<size_t> pick_shape(weights.begin(), weights.end());
+		const float side = glm::sqrt(scenario.area_per_body * num_bodies);
+		std::uniform_real_distribution<float> coordinate(0.f, side);
+		std::uniform_real_distribution<float> speed(-2.f, 2.f);
+		std::vector<const Shape*> body_shapes;
+		std::vector<glm::vec2> start_positions;
+		std::vector<glm::vec2> start_velocities;
+		for (long i = 0; i < num_bodies; ++i) {
+			body_shapes.push_back(&shapes[pick_shape(random)]);
+			start_positions.emplace_back(coordinate(random), coordinate(random));
+			start_velocities.emplace_back(speed(random), speed(random));
+		}
+		const long num_moving = static_cast<long>(scenario.moving_fraction * num_bodies);
+
+		for (auto type : { BroadphaseType::Grid, BroadphaseType::Tree }) {
+			auto broadphase = Broadphase::Create(type);
+			auto positions = start_positions;
+			auto velocities = start_velocities;
+			TransformComponent transform;
+			auto update = [&]() {
+				for (long i = 0; i < num_bodies; ++i) {
+					transform.position = positions[i];
+					broadphase->UpdateDynamic(static_cast<entt::entity>(i), transform, *body_shapes[i]);
+				}
+			};
+			// Inserting every body is not part of a step
+			update();
+			broadphase->GetPotentiallyIntersections();
+
+			double update_ms = 0.0;
+			double pairs_ms = 0.0;
+			double num_pairs = 0.0;
+			for (long step = 0; step < num_steps; ++step) {
+				for (long i = 0; i < num_moving; ++i) {
+					positions[i] += c_BenchmarkDt * velocities[i];
+					for (int axis = 0; axis < 2; ++axis) {
+						if (positions[i][axis] < 0.f || positions[i][axis] > side) {
+							velocities[i][axis] = -velocities[i][axis];
+						}
+					}
+				}
+
+				auto start = Clock::now();
+				update();
+				auto updated = Clock::now();
+				num_pairs += broadphase->GetPotentiallyIntersections().size();
+				auto end = Clock::now();
+				update_ms += std::chrono::duration<double, std::milli>(updated - start).count();
+				pairs_ms += std::chrono::duration<double, std::milli>(end - updated).count();
+			}
+
+			std::cout << scenario.name << "," << (type == BroadphaseType::Grid ? "grid" : "tree") << ","
+				<< num_bodies << "," << num_steps << "," << update_ms / num_steps << "," << pairs_ms / num_steps << ","
+				<< (update_ms + pairs_ms) / num_steps << "," << num_pairs / num_steps << std::endl;
+		}
+	}
+	return 0;
+}
+
+int RunPhysicsBenchmark(const BenchmarkArgs& args) {
+	const long num_steps = args.GetInt("--steps", 100);
+	const long num_warmup_steps = args.GetInt("--warmup", 0);
+	const std::string filter = args.Get("--filter", "");
+	if (num_steps <= 0 || num_warmup_steps < 0) {
+		std::cerr << "ERROR: invalid step count\n";
+		return 1;
+	}
+
+	SdfSettings sdf_settings;
+	const std::string sdf_format = args.Get("--sdf-format", "f32");
+	if (sdf_format == "i16") {
+		sdf_settings.format = SdfFormat::Int16;
+	} else if (sdf_format == "u8") {
+		sdf_settings.format = SdfFormat::UInt8;
+	} else if (sdf_format != "f32") {
+		std::cerr << "ERROR: unknown sdf format " << sdf_format << ", expected f32, i16 or u8\n";
+		return 1;
+	}
+	const std::string sdf_layout = args.Get("--sdf-layout", "row");
+	if (sdf_layout == "brick") {
+		sdf_settings.layout = SdfLayout::Bricked;
+	} else if (sdf_layout != "row") {
+		std::cerr << "ERROR: unknown sdf layout " << sdf_layout << ", expected row or brick\n";
+		return 1;
+	}
+	sdf_settings.gradients = args.Has("--sdf-gradients");
+	const std::string broadphase = args.Get("--broadphase", "grid");
+	if (broadphase != "grid" && broadphase != "tree") {
+		std::cerr << "ERROR: unknown broadphase " << broadphase << ", expected grid or tree\n";
+		return 1;
+	}
+
+	const std::vector<Scenario> scenarios = {
+		Pile(50),
+		Pile(500),
+		Pile(5000),
+		Pile(50000),
+		Stack(20),
+		Stack(100),
+		Pyramid(10),
+		Pyramid(30),
+		MixedPile(500),
+		MixedPile(5000),
+		CarvedPile(500),
+		LargePile(100),
+		TerrainPile(500),
+	};
+
+	std::cout << "scenario,bodies,steps,broadphase_insert_ms,broadphase_pairs_ms,narrowphase_ms,"
+		"plane_contacts_ms,contact_reduction_ms,solver_ms,integration_ms,total_ms,pairs,contacts,samples,culled_pairs\n";
+
+	for (auto& scenario : scenarios) {
+		auto full_name = scenario.name + "_" + std::to_string(scenario.num_bodies);
+		// Exact, so pile_500 does not also run pile_5000 and pile_50000
+		if (!filter.empty() && filter != full_name && filter != scenario.name) {
+			continue;
+		}
+		std::cerr << "Running " << full_name << "\n";
+
+		// Same shapes and positions between revisions
+		srand(101);
+		std::mt19937 random(101);
+
+		Simulation simulation;
+		auto& physics = simulation.GetSystemManager().Get<PhysicsSystem>();
+		physics.SetBroadphase(broadphase == "tree" ? BroadphaseType::Tree : BroadphaseType::Grid);
+		scenario.setup(simulation, random, sdf_settings);
+
+		for (long i = 0; i < num_warmup_steps; ++i) {
+			simulation.Update(c_BenchmarkDt);
+		}
+
+		PhysicsTimings sum;
+		double sum_pairs = 0.0;
+		double sum_contacts = 0.0;
+		double sum_samples = 0.0;
+		double sum_culled_pairs = 0.0;
+		for (long i = 0; i < num_steps; ++i) {
+			simulation.Update(c_BenchmarkDt);
+
+			auto& timings = physics.GetTimings();
+			sum.broadphase_insert += timings.broadphase_insert;
+			sum.broadphase_pairs += timings.broadphase_pairs;
+			sum.narrowphase += timings.narrowphase;
+			sum.plane_contacts += timings.plane_contacts;
+			sum.contact_reduction += timings.contact_reduction;
+			sum.solver += timings.solver;
+			sum.integration += timings.integration;
+			sum_pairs += timings.num_pairs;
+			sum_contacts += timings.num_contacts;
+			sum_samples += timings.num_samples;
+			sum_culled_pairs += timings.num_culled_pairs;
+		}
+
+		const float inverse_steps = 1.f / num_steps;
+		float total = sum.broadphase_insert + sum.broadphase_pairs + sum.narrowphase
+			+ sum.plane_contacts + sum.contact_reduction + sum.solver + sum.integration;
+		std::cout << scenario.name << "," << scenario.num_bodies << "," << num_steps << ","
+			<< sum.broadphase_insert * inverse_steps << ","
+			<< sum.broadphase_pairs * inverse_steps << ","
+			<< sum.narrowphase * inverse_steps << ","
+			<< sum.plane_contacts * inverse_steps << ","
+			<< sum.contact_reduction * inverse_steps << ","
+			<< sum.solver * inverse_steps << ","
+			<< sum.integration * inverse_steps << ","
+			<< total * inverse_steps << ","
+			<< sum_pairs * inverse_steps << ","
+			<< sum_contacts * inverse_steps << ","
+			<< sum_samples * inverse_steps << ","
+			<< sum_culled_pairs * inverse_steps << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,889 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <tuple>
+#include <glm/glm.hpp>
+#include <glm/gtc/noise.hpp>
+#include <glm/gtx/component_wise.hpp>
+
+#include "engine/shape/DistanceTransform.hpp"
+#include "engine/shape/SdfSmoothing.hpp"
+#include "engine/shape/ShapeImporter.hpp"
+#include "engine/shape/ShapePack.hpp"
+#include "engine/shape/ShapeMetadata.hpp"
+#include "engine/shape/Shape.hpp"
+
+namespace {
+
+/// The two pass 8SSEDT that ShapeSdf::Create used before the exact transform, kept as reference
+/// From http://www.codersnotes.com/notes/signed-distance-fields/
+void ReferenceSignedDistances(const std::vector<u8>& image, glm::uvec2 size, std::vector<float>& distances) {
+	struct Point {
+		glm::ivec2 delta{ 9999, 9999 };
+		int SquaredDistance() const {
+			return delta.x * delta.x + delta.y * delta.y;
+		}
+	};
+	class Grid {
+	public:
+		Grid(glm::uvec2 size) {
+			this->size = glm::ivec2(size);
+			points.resize(size.x * size.y);
+		}
+		Point Get(glm::ivec2 index) {
+			if (index.x >= 0 && index.y >= 0 && index.x < size.x && index.y < size.y) {
+				return points[index.x + index.y * size.x];
+			} else {
+				return {};
+			}
+		}
+		void Set(glm::ivec2 index, Point point) {
+			points[index.x + index.y * size.x] = point;
+		}
+		void GenerateSdf() {
+			for (i32 y = 0; y < size.y; ++y) {
+				for (i32 x = 0; x < size.x; ++x) {
+					Point point = Get({x, y});
+					Compare(point, {x,y}, {-1, 0});
+					Compare(point, {x,y}, {0, -1});
+					Compare(point, {x,y}, {-1, -1});
+					Compare(point, {x,y}, {1, -1});
+					Set({x, y}, point);
+				}
+				for (i32 x = size.x-1; x >= 0; --x) {
+					Point point = Get({x, y});
+					Compare(point, {x,y}, {1, 0});
+					Set({x, y}, point);
+				}
+			}
+
+			for (i32 y = size.y-1; y >= 0; --y) {
+				for (i32 x = size.x-1; x >= 0; --x) {
+					Point point = Get({x, y});
+					Compare(point, {x,y}, {1, 0});
+					Compare(point, {x,y}, {0, 1});
+					Compare(point, {x,y}, {-1, 1});
+					Compare(point, {x,y}, {1, 1});
+					Set({x, y}, point);
+				}
+				for (i32 x = 0; x < size.x; ++x) {
+					Point point = Get({x, y});
+					Compare(point, {x,y}, {-1, 0});
+					Set({x, y}, point);
+				}
+			}
+		}
+	private:
+		void Compare(Point& point, glm::ivec2 index, glm::ivec2 offset) {
+			Point other = Get(index + offset);
+			other.delta += offset;
+			if (other.SquaredDistance() < point.SquaredDistance()) {
+				point = other;
+			}
+		}
+		std::vector<Point> points;
+		glm::ivec2 size;
+	};
+
+	Grid outside_grid{ size };
+	Grid inside_grid{ size };
+
+	for (u32 y = 0; y < size.y; ++y) {
+		for (u32 x = 0; x < size.x; ++x) {
+			if (image[x + y * size.x] == c_MaterialEmptySpace) {
+				inside_grid.Set({ x, y }, { {0, 0} });
+			} else {
+				outside_grid.Set({ x, y }, { {0, 0} });
+			}
+		}
+	}
+
+	outside_grid.GenerateSdf();
+	inside_grid.GenerateSdf();
+
+	distances.resize(size.x * size.y);
+	for (u32 y = 0; y < size.y; ++y) {
+		for (u32 x = 0; x < size.x; ++x) {
+			float outside_distance = glm::sqrt(outside_grid.Get({x, y}).SquaredDistance());
+			float inside_distance = glm::sqrt(inside_grid.Get({x, y}).SquaredDistance());
+			if (outside_distance > 0.f) {
+				outside_distance -= 0.5f;
+			}
+			if (inside_distance > 0.f) {
+				inside_distance -= 0.5f;
+			}
+			distances[x + y * size.x] = outside_distance - inside_distance;
+		}
+	}
+}
+
+/// The scalar 3x3 smoothing ShapeSdf::Create used before SmoothDistances, kept as reference
+void ReferenceSmooth(const std::vector<float>& copy, glm::uvec2 size, std::vector<float>& distances, float& min_distance, float& max_distance) {
+	distances.resize(copy.size());
+	min_distance = std::numeric_limits<float>::max();
+	max_distance = std::numeric_limits<float>::lowest();
+
+	glm::mat3 kernel = {
+		1,2,1,
+		2,4,2,
+		1,2,1,
+	};
+	kernel *= 1.f / 16.f;
+	for (i32 y = 0; y < i32(size.y); ++y) {
+		for (i32 x = 0; x < i32(size.x); ++x) {
+			float sum = 0.f;
+			for (i32 yo = -1; yo <= 1; ++yo) {
+				for (i32 xo = -1; xo <= 1; ++xo) {
+					auto index = glm::clamp(glm::ivec2(x+xo, y+yo), glm::ivec2(0), glm::ivec2(size)-1);
+					sum += kernel[yo+1][xo+1] * copy[index.x + index.y * size.x];
+				}
+			}
+			sum *= 1.f / 9.f;
+
+			distances[x + y * size.x] = sum;
+
+			max_distance = glm::max(sum, max_distance);
+			min_distance = glm::min(sum, min_distance);
+		}
+	}
+}
+
+void ExactSignedDistances(const std::vector<u8>& image, glm::uvec2 size, std::vector<float>& distances) {
+	std::vector<i32> outside_squared;
+	std::vector<i32> inside_squared;
+	ComputeSquaredDistances(image, size, true, outside_squared);
+	ComputeSquaredDistances(image, size, false, inside_squared);
+
+	distances.resize(size.x * size.y);
+	for (size_t i = 0; i < distances.size(); ++i) {
+		float outside_distance = glm::sqrt(static_cast<float>(outside_squared[i]));
+		float inside_distance = glm::sqrt(static_cast<float>(inside_squared[i]));
+		if (outside_distance > 0.f) {
+			outside_distance -= 0.5f;
+		}
+		if (inside_distance > 0.f) {
+			inside_distance -= 0.5f;
+		}
+		distances[i] = outside_distance - inside_distance;
+	}
+}
+
+/// Shape::GenerateRandomShape before it moved to FastNoiseLite, kept as reference
+std::vector<u8> ReferenceRandomImage(glm::uvec2 size) {
+	std::vector<u8> image(glm::compMul(size));
+
+	auto rand_x = 0.03f * (rand() % 2000);
+	auto rand_y = 0.03f * (rand() % 2000);
+
+	glm::vec2 center = glm::vec2(size) * 0.5f;
+	float radius = center.x;
+	for (u32 y = 0; y < size.y; ++y) {
+		for (u32 x = 0; x < size.x; ++x) {
+			auto pos = glm::vec2(x, y);
+			float noise = 0.5f + 0.5f * glm::simplex(0.02f * pos + glm::vec2(rand_x, rand_y));
+
+			noise *= glm::smoothstep(radius, radius*0.5f, glm::length(radius - pos));
+
+			auto& pixel = image[x + y * size.x];
+			if (noise > 0.5f) {
+				pixel = 1;
+			} else {
+				pixel = c_MaterialEmptySpace;
+			}
+		}
+	}
+	return image;
+}
+
+/// Moments the way shapes counted them before the occupancy, one pixel at a time
+PixelMoments ReferenceMoments(const std::vector<u8>& image, glm::uvec2 size) {
+	PixelMoments moments;
+	for (u32 y = 0; y < size.y; ++y) {
+		for (u32 x = 0; x < size.x; ++x) {
+			if (image[x + y * size.x] != c_MaterialEmptySpace) {
+				++moments.count;
+				moments.sum_x += x;
+				moments.sum_y += y;
+				moments.sum_xx += u64(x) * x;
+				moments.sum_yy += u64(y) * y;
+			}
+		}
+	}
+	return moments;
+}
+
+/// Noise blobs with holes, similar to Shape::GenerateRandomImage but without the circular falloff
+std::vector<u8> CreateNoiseImage(glm::uvec2 size) {
+	std::vector<u8> image(size.x * size.y);
+	const float frequency = 8.f / size.x;
+	for (u32 y = 0; y < size.y; ++y) {
+		for (u32 x = 0; x < size.x; ++x) {
+			float noise = glm::simplex(frequency * glm::vec2(x, y));
+			image[x + y * size.x] = noise > 0.f ? 1 : c_MaterialEmptySpace;
+		}
+	}
+	return image;
+}
+
+template <class Func>
+double MeasureMilliseconds(long repetitions, Func&& func) {
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < repetitions; ++i) {
+		func();
+	}
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+}
+
+
+/// Random blobs of 512 pixels tiled over the image, like a level made of rocks
+std::vector<u8> CreateLevelImage(glm::uvec2 size) {
+	std::vector<u8> image(size_t(size.x) * size.y, c_MaterialEmptySpace);
+	constexpr u32 c_BlobSize = 512;
+	u32 seed = 0;
+	for (u32 min_y = 0; min_y < size.y; min_y += c_BlobSize) {
+		for (u32 min_x = 0; min_x < size.x; min_x += c_BlobSize) {
+			auto blob = Shape::GenerateRandomImage(glm::uvec2(c_BlobSize), seed++);
+			for (u32 y = 0; y < c_BlobSize && min_y + y < size.y; ++y) {
+				for (u32 x = 0; x < c_BlobSize && min_x + x < size.x; ++x) {
+					image[(min_x + x) + size_t(min_y + y) * size.x] = blob[x + y * c_BlobSize];
+				}
+			}
+		}
+	}
+	return image;
+}
+
+bool WritePgm(const std::string& path, glm::uvec2 size, const std::vector<u8>& image) {
+	std::ofstream file(path, std::ios::binary);
+	file << "P5\n" << size.x << " " << size.y << "\n255\n";
+	file.write(reinterpret_cast<const char*>(image.data()), image.size());
+	return static_cast<bool>(file);
+}
+
+/// 8 bit gray png with uncompressed deflate blocks, the bench has no compressor
+bool WriteStoredPng(const std::string& path, glm::uvec2 size, const std::vector<u8>& image) {
+	std::vector<u32> crc_table(256);
+	for (u32 i = 0; i < 256; ++i) {
+		u32 c = i;
+		for (int bit = 0; bit < 8; ++bit) {
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		}
+		crc_table[i] = c;
+	}
+	auto append_u32 = [](std::vector<u8>& out, u32 value) {
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			out.push_back(static_cast<u8>(value >> shift));
+		}
+	};
+	std::ofstream file(path, std::ios::binary);
+	auto write_chunk = [&](const char* type, const std::vector<u8>& data) {
+		std::vector<u8> chunk;
+		append_u32(chunk, static_cast<u32>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		u32 crc = ~0u;
+		for (size_t i = 4; i < chunk.size(); ++i) {
+			crc = crc_table[(crc ^ chunk[i]) & 255] ^ (crc >> 8);
+		}
+		append_u32(chunk, ~crc);
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	};
+
+	const u8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), 8);
+	std::vector<u8> header;
+	append_u32(header, size.x);
+	append_u32(header, size.y);
+	header.insert(header.end(), { 8, 0, 0, 0, 0 });
+	write_chunk("IHDR", header);
+
+	// One row per stored block, each row is the filter byte and the pixels
+	std::vector<u8> data = { 0x78, 0x01 };
+	u32 adler_a = 1;
+	u32 adler_b = 0;
+	for (u32 y = 0; y < size.y; ++y) {
+		std::vector<u8> row(1, 0);
+		row.insert(row.end(), image.begin() + size_t(y) * size.x, image.begin() + size_t(y + 1) * size.x);
+		for (size_t offset = 0; offset < row.size(); offset += 65535) {
+			const u32 length = static_cast<u32>(std::min<size_t>(65535, row.size() - offset));
+			const bool last = y + 1 == size.y && offset + length == row.size();
+			data.insert(data.end(), { u8(last ? 1 : 0), u8(length), u8(length >> 8), u8(~length), u8(~length >> 8) });
+			data.insert(data.end(), row.begin() + offset, row.begin() + offset + length);
+		}
+		for (u8 value : row) {
+			adler_a = (adler_a + value) % 65521;
+			adler_b = (adler_b + adler_a) % 65521;
+		}
+		if (data.size() > (1 << 20) || y + 1 == size.y) {
+			if (y + 1 == size.y) {
+				append_u32(data, (adler_b << 16) | adler_a);
+			}
+			write_chunk("IDAT", data);
+			data.clear();
+		}
+	}
+	write_chunk("IEND", {});
+	return static_cast<bool>(file);
+}
+}
+
+int RunSdfBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 4096);
+	const bool skip_reference = args.Has("--skip-reference");
+
+	std::cout << "size,reference_ms,exact_ms,create_ms,max_difference,num_different,"
+		"reference_smooth_ms,smooth_ms,smooth_max_difference\n";
+	for (u32 size = 64; size <= max_size; size *= 2) {
+		std::cerr << "Running " << size << "x" << size << "\n";
+		auto image = CreateNoiseImage(glm::uvec2(size));
+		const long repetitions = glm::max(1l, 4096l * 4096l / (16l * size * size));
+
+		std::vector<float> exact;
+		double exact_ms = MeasureMilliseconds(repetitions, [&]() {
+			ExactSignedDistances(image, glm::uvec2(size), exact);
+		});
+
+		ShapeSdf sdf;
+		double create_ms = MeasureMilliseconds(repetitions, [&]() {
+			sdf.Create(image, glm::uvec2(size));
+		});
+
+		double reference_ms = 0.0;
+		float max_difference = 0.f;
+		u64 num_different = 0;
+		if (!skip_reference) {
+			std::vector<float> reference;
+			reference_ms = MeasureMilliseconds(repetitions, [&]() {
+				ReferenceSignedDistances(image, glm::uvec2(size), reference);
+			});
+			for (size_t i = 0; i < exact.size(); ++i) {
+				float difference = glm::abs(exact[i] - reference[i]);
+				max_difference = glm::max(max_difference, difference);
+				num_different += difference > 0.001f;
+			}
+		}
+
+		std::vector<float> reference_smoothed;
+		std::vector<float> smoothed;
+		float min_distance;
+		float max_distance;
+		double reference_smooth_ms = MeasureMilliseconds(repetitions, [&]() {
+			ReferenceSmooth(exact, glm::uvec2(size), reference_smoothed, min_distance, max_distance);
+		});
+		double smooth_ms = MeasureMilliseconds(repetitions, [&]() {
+			SmoothDistances(exact, glm::uvec2(size), smoothed, min_distance, max_distance);
+		});
+		float smooth_max_difference = 0.f;
+		for (size_t i = 0; i < smoothed.size(); ++i) {
+			smooth_max_difference = glm::max(smooth_max_difference, glm::abs(smoothed[i] - reference_smoothed[i]));
+		}
+
+		std::cout << size << "," << reference_ms << "," << exact_ms << "," << create_ms << ","
+			<< max_difference << "," << num_different << ","
+			<< reference_smooth_ms << "," << smooth_ms << "," << smooth_max_difference << std::endl;
+	}
+	return 0;
+}
+
+int RunSdfEditBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 4096);
+	const long radius = args.GetInt("--radius", 8);
+	const long num_edits = args.GetInt("--edits", 32);
+	const SdfStorage storage = args.Has("--tiled") ? SdfStorage::Tiled : SdfStorage::Dense;
+	if (radius <= 0 || num_edits <= 0) {
+		std::cerr << "ERROR: invalid radius or edit count\n";
+		return 1;
+	}
+
+	std::cout << "size,radius,edits,create_ms,update_ms,updated_pixels,max_difference\n";
+	for (u32 size = 64; size <= max_size; size *= 2) {
+		std::cerr << "Running " << size << "x" << size << "\n";
+		const glm::uvec2 image_size(size);
+		auto image = CreateNoiseImage(image_size);
+
+		ShapeSdf sdf;
+		double create_ms = MeasureMilliseconds(1, [&]() {
+			sdf.Create(image, image_size, { storage });
+		});
+
+		// Alternately carve and fill circles centered on the surface, like a digging brush
+		std::mt19937 random(101);
+		std::uniform_int_distribution<u32> position(0, size - 1);
+		double update_ms = 0.0;
+		u64 updated_pixels = 0;
+		for (long edit = 0; edit < num_edits; ++edit) {
+			glm::ivec2 center;
+			do {
+				center = glm::ivec2(position(random), position(random));
+			} while (glm::abs(sdf.GetDistance(center)) > 1.f);
+
+			PixelRect rect;
+			rect.min = glm::uvec2(glm::max(center - i32(radius), glm::ivec2(0)));
+			rect.max = glm::uvec2(glm::min(center + i32(radius) + 1, glm::ivec2(image_size)));
+			const u8 material = edit % 2 == 0 ? c_MaterialEmptySpace : 1;
+			for (u32 y = rect.min.y; y < rect.max.y; ++y) {
+				for (u32 x = rect.min.x; x < rect.max.x; ++x) {
+					glm::ivec2 diff = glm::ivec2(x, y) - center;
+					if (diff.x * diff.x + diff.y * diff.y <= radius * radius) {
+						image[x + y * size] = material;
+					}
+				}
+			}
+
+			PixelRect updated;
+			update_ms += MeasureMilliseconds(1, [&]() {
+				updated = sdf.Update(image, rect);
+			});
+			updated_pixels += u64(updated.GetSize().x) * updated.GetSize().y;
+		}
+
+		// Tiled sdfs are only exact inside the band
+		ShapeSdf reference;
+		reference.Create(image, image_size);
+		const float band = c_SdfBandPixels * c_SdfDistanceScale;
+		float max_difference = 0.f;
+		for (i32 y = 0; y < i32(size); ++y) {
+			for (i32 x = 0; x < i32(size); ++x) {
+				float distance = reference.GetDistance({ x, y });
+				if (storage == SdfStorage::Dense || glm::abs(distance) <= band) {
+					max_difference = glm::max(max_difference, glm::abs(distance - sdf.GetDistance({ x, y })));
+				}
+			}
+		}
+
+		std::cout << size << "," << radius << "," << num_edits << "," << create_ms << ","
+			<< update_ms / num_edits << "," << updated_pixels / num_edits << "," << max_difference << std::endl;
+	}
+	return 0;
+}
+
+int RunSdfTiledBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 4096);
+	const long num_samples = args.GetInt("--samples", 1 << 20);
+	if (num_samples <= 0) {
+		std::cerr << "ERROR: invalid sample count\n";
+		return 1;
+	}
+
+	std::cout << "size,dense_bytes,tiled_bytes,dense_tiles,tiles,band_max_difference,dense_sample_ns,tiled_sample_ns\n";
+	for (u32 size = 256; size <= max_size; size *= 2) {
+		std::cerr << "Running " << size << "x" << size << "\n";
+		const glm::uvec2 image_size(size);
+		auto image = CreateNoiseImage(image_size);
+
+		ShapeSdf dense;
+		dense.Create(image, image_size, { SdfStorage::Dense });
+		ShapeSdf tiled;
+		tiled.Create(image, image_size, { SdfStorage::Tiled });
+
+		// Positions inside the band, where the narrowphase finds its contacts
+		const float band = (c_SdfBandPixels - 2.f) * c_SdfDistanceScale;
+		std::mt19937 random(101);
+		std::uniform_real_distribution<float> coordinate(0.f, (size - 1) * c_PixelSizeMeters);
+		std::vector<glm::vec2> positions;
+		while (positions.size() < static_cast<size_t>(num_samples)) {
+			glm::vec2 position(coordinate(random), coordinate(random));
+			if (glm::abs(dense.GetDistanceAndGradient(position).first) < band) {
+				positions.push_back(position);
+			}
+		}
+
+		float band_max_difference = 0.f;
+		for (auto& position : positions) {
+			auto [dense_distance, dense_gradient] = dense.GetDistanceAndGradient(position);
+			auto [tiled_distance, tiled_gradient] = tiled.GetDistanceAndGradient(position);
+			band_max_difference = glm::max(band_max_difference, glm::abs(dense_distance - tiled_distance));
+			band_max_difference = glm::max(band_max_difference, glm::compMax(glm::abs(dense_gradient - tiled_gradient)));
+		}
+
+		float sum = 0.f;
+		double dense_ns = 1e6 * MeasureMilliseconds(1, [&]() {
+			for (auto& position : positions) {
+				sum += dense.GetDistanceAndGradient(position).first;
+			}
+		}) / positions.size();
+		double tiled_ns = 1e6 * MeasureMilliseconds(1, [&]() {
+			for (auto& position : positions) {
+				sum += tiled.GetDistanceAndGradient(position).first;
+			}
+		}) / positions.size();
+		if (sum == 0.f) {
+			std::cerr << "\n";
+		}
+
+		auto dense_usage = dense.GetMemoryUsage();
+		auto tiled_usage = tiled.GetMemoryUsage();
+		std::cout << size << "," << dense_usage.bytes << "," << tiled_usage.bytes << ","
+			<< tiled_usage.num_dense_tiles << "," << tiled_usage.num_tiles << ","
+			<< band_max_difference << "," << dense_ns << "," << tiled_ns << std::endl;
+	}
+	return 0;
+}
+
+int RunSdfFormatBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 1024);
+	const long num_samples = args.GetInt("--samples", 1 << 20);
+	if (num_samples <= 0) {
+		std::cerr << "ERROR: invalid sample count\n";
+		return 1;
+	}
+
+	struct Format {
+		const char* name;
+		SdfFormat format;
+	};
+	const Format formats[] = {
+		{ "f32", SdfFormat::Float32 },
+		{ "i16", SdfFormat::Int16 },
+		{ "u8", SdfFormat::UInt8 },
+	};
+
+	std::cout << "size,case,format,bytes,max_error_pixels,sample_ns\n";
+	for (u32 size = 32; size <= max_size; size *= 2) {
+		std::cerr << "Running " << size << "x" << size << "\n";
+		const glm::uvec2 image_size(size);
+		Shape shape(image_size);
+
+		std::mt19937 random(101);
+		std::uniform_real_distribution<float> coordinate(0.f, (size - 1) * c_PixelSizeMeters);
+		std::vector<glm::vec2> positions(num_samples);
+		for (auto& position : positions) {
+			position = glm::vec2(coordinate(random), coordinate(random));
+		}
+
+		// Created without solid pixels and then painted, the quantized range has to grow
+		const std::vector<u8> empty_image(size * size, 0);
+		std::vector<u8> painted_image = empty_image;
+		const PixelRect painted_rect{ glm::uvec2(size / 4), glm::uvec2(3 * size / 4) };
+		for (u32 y = painted_rect.min.y; y < painted_rect.max.y; ++y) {
+			for (u32 x = painted_rect.min.x; x < painted_rect.max.x; ++x) {
+				const glm::vec2 offset = glm::vec2(x, y) + 0.5f - 0.5f * float(size);
+				painted_image[x + y * size] = glm::dot(offset, offset) <= 0.0625f * float(size * size);
+			}
+		}
+		auto create_painted = [&](SdfFormat format) {
+			ShapeSdf sdf;
+			sdf.Create(empty_image, image_size, { SdfStorage::Dense, format });
+			sdf.Update(painted_image, painted_rect);
+			return sdf;
+		};
+		const ShapeSdf painted_reference = create_painted(SdfFormat::Float32);
+
+		for (bool painted : { false, true }) {
+			auto& reference = painted ? painted_reference : shape.GetSdf();
+			for (auto& format : formats) {
+				ShapeSdf sdf;
+				if (painted) {
+					sdf = create_painted(format.format);
+				} else {
+					sdf.Create(shape.GetImage(), image_size, { SdfStorage::Dense, format.format });
+				}
+
+				float max_error = 0.f;
+				for (i32 y = 0; y < i32(size); ++y) {
+					for (i32 x = 0; x < i32(size); ++x) {
+						max_error = glm::max(max_error, glm::abs(reference.GetDistance({ x, y }) - sdf.GetDistance({ x, y })));
+					}
+				}
+
+				float sum = 0.f;
+				double sample_ns = 1e6 * MeasureMilliseconds(1, [&]() {
+					for (auto& position : positions) {
+						sum += sdf.GetDistanceAndGradient(position).first;
+					}
+				}) / positions.size();
+				if (sum == 0.f) {
+					std::cerr << "\n";
+				}
+
+				std::cout << size << "," << (painted ? "painted" : "random") << "," << format.name << ","
+					<< sdf.GetMemoryUsage().bytes << "," << max_error / c_SdfDistanceScale << "," << sample_ns << std::endl;
+			}
+		}
+	}
+	return 0;
+}
+
+int RunSdfSampleBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 1024);
+	const long num_samples = args.GetInt("--samples", 1 << 20);
+	const long batch_size = args.GetInt("--batch", 64);
+	if (num_samples <= 0 || batch_size <= 0) {
+		std::cerr << "ERROR: invalid sample or batch count\n";
+		return 1;
+	}
+
+	std::cout << "size,scalar_ns,batch_ns,max_distance_difference,max_gradient_difference,"
+		"smoothed_taps_ns,smoothed_field_ns,mean_smoothed_difference\n";
+	for (u32 size = 32; size <= max_size; size *= 2) {
+		std::cerr << "Running " << size << "x" << size << "\n";
+		const glm::uvec2 image_size(size);
+		const auto image = CreateNoiseImage(image_size);
+		ShapeSdf sdf;
+		sdf.Create(image, image_size);
+		SdfSettings gradient_settings;
+		gradient_settings.gradients = true;
+		ShapeSdf gradient_sdf;
+		gradient_sdf.Create(image, image_size, gradient_settings);
+
+		// Some positions outside the image to cover the clamped path
+		std::mt19937 random(101);
+		std::uniform_real_distribution<float> coordinate(-0.1f * size * c_PixelSizeMeters, 1.1f * size * c_PixelSizeMeters);
+		std::vector<float> x(num_samples);
+		std::vector<float> y(num_samples);
+		for (long i = 0; i < num_samples; ++i) {
+			x[i] = coordinate(random);
+			y[i] = coordinate(random);
+		}
+
+		std::vector<float> scalar_distances(num_samples);
+		std::vector<glm::vec2> scalar_gradients(num_samples);
+		double scalar_ns = 1e6 * MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < num_samples; ++i) {
+				std::tie(scalar_distances[i], scalar_gradients[i]) = sdf.GetDistanceAndGradient({ x[i], y[i] });
+			}
+		}) / num_samples;
+
+		std::vector<float> distances(num_samples);
+		std::vector<float> gradient_x(num_samples);
+		std::vector<float> gradient_y(num_samples);
+		double batch_ns = 1e6 * MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < num_samples; i += batch_size) {
+				const u32 count = static_cast<u32>(glm::min(batch_size, num_samples - i));
+				sdf.GetDistancesAndGradients(count, &x[i], &y[i], &distances[i], &gradient_x[i], &gradient_y[i]);
+			}
+		}) / num_samples;
+
+		float max_distance_difference = 0.f;
+		float max_gradient_difference = 0.f;
+		for (long i = 0; i < num_samples; ++i) {
+			max_distance_difference = glm::max(max_distance_difference, glm::abs(distances[i] - scalar_distances[i]));
+			max_gradient_difference = glm::max(max_gradient_difference,
+				glm::compMax(glm::abs(glm::vec2(gradient_x[i], gradient_y[i]) - scalar_gradients[i])));
+		}
+
+		// Contact normals, averaged from four taps or read from the gradient field
+		std::vector<glm::vec2> taps(num_samples);
+		std::vector<glm::vec2> field(num_samples);
+		double taps_ns = 1e6 * MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < num_samples; ++i) {
+				taps[i] = sdf.GetSmoothedGradient({ x[i], y[i] });
+			}
+		}) / num_samples;
+		double field_ns = 1e6 * MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < num_samples; ++i) {
+				field[i] = gradient_sdf.GetSmoothedGradient({ x[i], y[i] });
+			}
+		}) / num_samples;
+
+		// Near the surface, where contacts are. Across the medial axis of thin parts the
+		// interpolated field and the taps can point in very different directions.
+		double sum_smoothed_difference = 0.0;
+		long num_near_surface = 0;
+		for (long i = 0; i < num_samples; ++i) {
+			if (glm::abs(scalar_distances[i]) < 2.f * c_SdfDistanceScale && glm::length(taps[i]) > 0.f) {
+				sum_smoothed_difference += glm::length(field[i] - glm::normalize(taps[i]));
+				++num_near_surface;
+			}
+		}
+		const double mean_smoothed_difference = sum_smoothed_difference / glm::max(num_near_surface, 1l);
+
+		std::cout << size << "," << scalar_ns << "," << batch_ns << ","
+			<< max_distance_difference << "," << max_gradient_difference << ","
+			<< taps_ns << "," << field_ns << "," << mean_smoothed_difference << std::endl;
+	}
+	return 0;
+}
+
+int RunShapeGenerationBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 256);
+	const long num_shapes = args.GetInt("--shapes", 1000);
+	if (num_shapes <= 0) {
+		std::cerr << "ERROR: invalid shape count\n";
+		return 1;
+	}
+
+	std::cout << "size,shapes,reference_image_ms,image_ms,shape_ms,reference_solid_fraction,solid_fraction\n";
+	for (u32 size = 16; size <= max_size; size *= 2) {
+		std::cerr << "Running " << size << "x" << size << "\n";
+		const glm::uvec2 image_size(size);
+
+		srand(101);
+		u64 reference_solid = 0;
+		double reference_ms = MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < num_shapes; ++i) {
+				auto image = ReferenceRandomImage(image_size);
+				reference_solid += std::count(image.begin(), image.end(), 1);
+			}
+		});
+
+		u64 solid = 0;
+		double image_ms = MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < num_shapes; ++i) {
+				auto image = Shape::GenerateRandomImage(image_size, static_cast<u32>(i));
+				solid += std::count(image.begin(), image.end(), 1);
+			}
+		});
+
+		// Including the sdf, what creating the shapes at load costs
+		double shape_ms = MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < num_shapes; ++i) {
+				Shape shape(image_size, static_cast<u32>(i));
+			}
+		});
+
+		const double num_pixels = double(num_shapes) * size * size;
+		std::cout << size << "," << num_shapes << "," << reference_ms << "," << image_ms << "," << shape_ms << ","
+			<< reference_solid / num_pixels << "," << solid / num_pixels << std::endl;
+	}
+	return 0;
+}
+
+int RunShapePackBenchmark(const BenchmarkArgs& args) {
+	const long num_shapes = args.GetInt("--shapes", 2000);
+	const long max_size = args.GetInt("--max-size", 256);
+	const std::string path = args.Get("--path", "shape_pack_bench.pack");
+	if (num_shapes <= 0) {
+		std::cerr << "ERROR: invalid shape count\n";
+		return 1;
+	}
+
+	std::cout << "size,shapes,create_ms,write_ms,read_ms,pack_bytes,identical\n";
+	for (u32 size = 32; size <= max_size; size *= 2) {
+		// Same pixel count for every size
+		const long count = glm::max(1l, num_shapes * 32 * 32 / long(size * size));
+		std::cerr << "Running " << count << " shapes of " << size << "x" << size << "\n";
+
+		std::vector<Shape> shapes;
+		shapes.reserve(count);
+		double create_ms = MeasureMilliseconds(1, [&]() {
+			for (long i = 0; i < count; ++i) {
+				shapes.emplace_back(glm::uvec2(size), static_cast<u32>(i));
+			}
+		});
+
+		std::vector<const Shape*> pack;
+		for (auto& shape : shapes) {
+			pack.push_back(&shape);
+		}
+		bool written = false;
+		double write_ms = MeasureMilliseconds(1, [&]() {
+			written = WriteShapePack(path, pack);
+		});
+
+		std::vector<Shape> loaded;
+		bool read = false;
+		double read_ms = MeasureMilliseconds(1, [&]() {
+			read = written && ReadShapePack(path, loaded);
+		});
+		if (!read) {
+			std::remove(path.c_str());
+			return 1;
+		}
+
+		u64 pack_bytes = 0;
+		bool identical = loaded.size() == shapes.size();
+		for (size_t i = 0; identical && i < shapes.size(); ++i) {
+			auto& before = shapes[i];
+			auto& after = loaded[i];
+			pack_bytes += after.GetImage().size() + after.GetSdf().GetMemoryUsage().bytes;
+			identical = before.GetImage() == after.GetImage() && before.GetNumSolidPixels() == after.GetNumSolidPixels();
+			for (u32 y = 0; identical && y < size; ++y) {
+				for (u32 x = 0; identical && x < size; ++x) {
+					identical = before.GetSdf().GetDistance(glm::ivec2(x, y)) == after.GetSdf().GetDistance(glm::ivec2(x, y));
+				}
+			}
+		}
+		std::remove(path.c_str());
+
+		std::cout << size << "," << count << "," << create_ms << "," << write_ms << "," << read_ms << ","
+			<< pack_bytes << "," << (identical ? "yes" : "no") << std::endl;
+	}
+	return 0;
+}
+
+int RunShapeImportBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 4096);
+	const long max_shape_size = args.GetInt("--max-shape-size", 1024);
+	const std::string path = args.Get("--path", "shape_import_bench");
+	if (max_size < 512 || max_shape_size <= 0) {
+		std::cerr << "ERROR: invalid size\n";
+		return 1;
+	}
+
+	std::cout << "format,size,max_shape_size,shapes,import_ms,whole_ms,streamed_source_bytes,whole_source_bytes\n";
+	for (u32 size = 1024; size <= max_size; size *= 2) {
+		const glm::uvec2 image_size(size);
+		auto image = CreateLevelImage(image_size);
+
+		for (const std::string format : { "pgm", "png" }) {
+			std::cerr << "Running " << format << " " << size << "x" << size << "\n";
+			const std::string file_path = path + "." + format;
+			if (!(format == "pgm" ? WritePgm(file_path, image_size, image) : WriteStoredPng(file_path, image_size, image))) {
+				std::cerr << "ERROR: could not write " << file_path << "\n";
+				return 1;
+			}
+
+			ShapeImportSettings settings;
+			settings.max_shape_size = static_cast<u32>(max_shape_size);
+			std::vector<ImportedShape> shapes;
+			bool imported = false;
+			double import_ms = MeasureMilliseconds(1, [&]() {
+				imported = ImportShapes(file_path, settings, shapes);
+			});
+			std::remove(file_path.c_str());
+			if (!imported) {
+				return 1;
+			}
+
+			// What the importer replaces, the whole source in memory and one sdf over all of it
+			double whole_ms = MeasureMilliseconds(1, [&]() {
+				Shape shape(image_size, image);
+			});
+
+			std::cout << format << "," << size << "," << max_shape_size << "," << shapes.size() << ","
+				<< import_ms << "," << whole_ms << "," << u64(size) * glm::min<u32>(size, max_shape_size) << ","
+				<< u64(size) * size << std::endl;
+		}
+	}
+	return 0;
+}
+
+int RunShapeMassBenchmark(const BenchmarkArgs& args) {
+	const long max_size = args.GetInt("--max-size", 4096);
+	const long repetitions = args.GetInt("--repetitions", 20);
+	if (max_size < 64 || repetitions <= 0) {
+		std::cerr << "ERROR: invalid size or repetitions\n";
+		return 1;
+	}
+
+	std::cout << "size,solid_pixels,image_bytes,occupancy_bytes,byte_walk_ms,popcount_ms,identical\n";
+	for (u32 size = 64; size <= max_size; size *= 2) {
+		std::cerr << "Running " << size << "x" << size << "\n";
+		Shape shape(glm::uvec2(size), CreateNoiseImage(glm::uvec2(size)));
+		const PixelRect whole_shape{ glm::uvec2(0), shape.GetSize() };
+
+		PixelMoments reference;
+		double byte_walk_ms = MeasureMilliseconds(repetitions, [&]() {
+			reference = ReferenceMoments(shape.GetImage(), shape.GetSize());
+		});
+		PixelMoments moments;
+		double popcount_ms = MeasureMilliseconds(repetitions, [&]() {
+			moments = shape.CountSolidMoments(whole_shape);
+		});
+		const bool identical = reference == moments && moments == shape.GetSolidMoments();
+
+		std::cout << size << "," << moments.count << "," << shape.GetImage().size() << ","
+			<< shape.GetOccupancy().size() * sizeof(u64) << "," << byte_walk_ms << "," << popcount_ms << ","
+			<< (identical ? "yes" : "no") << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+
+/// Body that never moves, its TransformComponent is at the shape corner. Contacts with it are
+/// only kept between contact_min and contact_max, so overlapping terrain tiles do not both
+/// push at the same point.
+struct StaticBodyComponent {
+	glm::vec2 contact_min{};
+	glm::vec2 contact_max{};
+};
@@ -1,21 +1,34 @@
 #include "PhysicsSystem.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/gtx/norm.hpp>
 #include "engine/SystemManager.hpp"
 #include "engine/shape/ShapeManager.hpp"
 #include "engine/shape/ShapeMetadata.hpp"
+#include "engine/shape/SdfSmoothing.hpp"
+#include "ecs/components/StaticBody.hpp"
 #include "ecs/components/Transform.hpp"
 #include "graphics/DebugDrawing.hpp"
 #include "engine/Broadphase.hpp"
-#include "Input.hpp"
+#include "engine/Terrain.hpp"
+#include "util/Profiler.hpp"
+
+constexpr float c_Density = 100.0f;
+/// Smoothing and quantization can make sdf distances a little too large
+constexpr float c_MarchSlackMeters = 4.f * c_PixelSizeMeters;
+constexpr size_t c_MaxManifoldContacts = 4;
 
 struct PhysicsComponent {
 	glm::vec2 velocity{};
 	float angular_velocity = 0.f;
 	glm::vec2 center_of_mass{};
 	float mass = 0.f;
+	float inertia = 0.f;
 };
 
 glm::vec2 CalculateVelocityAt(const PhysicsComponent& physics, const TransformComponent& transform, glm::vec2 position) {
@@ -26,20 +39,67 @@ glm::vec2 CalculateVelocityAt(const PhysicsComponent& physics, const TransformCo
 void ApplyImpulseAt(PhysicsComponent& physics, const TransformComponent& transform, glm::vec2 impulse, glm::vec2 position) {
 	auto pivot = position - transform.position;
 	physics.velocity += impulse / physics.mass;
-	physics.angular_velocity += pivot.x * impulse.y - pivot.y * impulse.x;
+	physics.angular_velocity += (pivot.x * impulse.y - pivot.y * impulse.x) / physics.inertia;
+}
+
+/// Inverse of the mass the impulse along direction at position sees
+float CalculateInverseMassAt(const PhysicsComponent& physics, const TransformComponent& transform, glm::vec2 direction, glm::vec2 position) {
+	auto pivot = position - transform.position;
+	const float arm = pivot.x * direction.y - pivot.y * direction.x;
+	return 1.0f / physics.mass + arm * arm / physics.inertia;
+}
+
+/// Box around the solid pixels of a shape in world space
+struct OrientedBox {
+	glm::vec2 center;
+	/// Columns are the box axes
+	glm::mat2 axes;
+	glm::vec2 half_size;
+};
+
+OrientedBox CalculateSolidBox(const Shape& shape, glm::vec2 shape_corner, const glm::mat2& rotation) {
+	auto& bounds = shape.GetSolidBounds();
+	const glm::vec2 local_center = shape.GetSolidCenter() + 0.5f * (bounds.box_min + bounds.box_max);
+	return { shape_corner + rotation * local_center, rotation, 0.5f * (bounds.box_max - bounds.box_min) };
+}
+
+/// Separating axis test, each box is grown by slack on every side
+bool OrientedBoxesOverlap(const OrientedBox& a, const OrientedBox& b, float slack) {
+	const glm::vec2 offset = b.center - a.center;
+	for (auto* box : { &a, &b }) {
+		for (int i = 0; i < 2; ++i) {
+			const glm::vec2 axis = box->axes[i];
+			const float extent_a = a.half_size.x * glm::abs(glm::dot(a.axes[0], axis)) + a.half_size.y * glm::abs(glm::dot(a.axes[1], axis));
+			const float extent_b = b.half_size.x * glm::abs(glm::dot(b.axes[0], axis)) + b.half_size.y * glm::abs(glm::dot(b.axes[1], axis));
+			if (glm::abs(glm::dot(offset, axis)) > extent_a + extent_b + 2.f * slack) {
+				return false;
+			}
+		}
+	}
+	return true;
 }
 
 PhysicsSystem::PhysicsSystem(SystemManager& system_manager)
 	: m_entity_manager{ system_manager.Get<EntityManager>() }
 	, m_shape_manager{ system_manager.Get<ShapeManager>() }
 	, m_debug_drawing{ system_manager.Get<DebugDrawing>() }
-	, m_input{ system_manager.Get<Input>() }
-	, m_broadphase{ std::make_unique<Broadphase>(system_manager) }
+	, m_terrain{ system_manager.Get<Terrain>() }
+	, m_broadphase{ Broadphase::Create(m_broadphase_type) }
 {
 	system_manager.OnUpdate().connect<&PhysicsSystem::Update>(this);
 	system_manager.OnInitialize().connect<&PhysicsSystem::Initialize>(this);
+	m_shape_manager.OnShapeEdited().connect<&PhysicsSystem::OnShapeEdited>(this);
+	m_terrain.OnTileLoaded().connect<&PhysicsSystem::OnTerrainTileLoaded>(this);
+	m_terrain.OnTileUnloaded().connect<&PhysicsSystem::OnTerrainTileUnloaded>(this);
+	m_entity_manager.on_destroy<PhysicsComponent>().connect<&PhysicsSystem::OnBodyDestroyed>(this);
 
 	m_dragging_entity = m_entity_manager.invalid_entity();
+
+	m_planes = {
+		{ glm::vec2(0, 0), glm::vec2(0, 1) },
+		{ glm::vec2(0, 0), glm::vec2(1, 0) },
+		{ glm::vec2(6, 0), glm::vec2(-1, 0) },
+	};
 }
 
 PhysicsSystem::~PhysicsSystem() {}
@@ -50,24 +110,9 @@ void PhysicsSystem::Initialize() {
 	auto random = [](){ return rand() / float(RAND_MAX); };
 
 	auto create_entity = [this](glm::vec2 pos, float rotation = 0.f){
-		auto entity = m_entity_manager.create();
-
 		auto size = glm::uvec2(64);
-		auto& shape = m_shape_manager.CreateShape(Shape(size));
-		m_entity_manager.emplace<ShapeId>(entity, shape.GetId());
-
-		auto& transform = m_entity_manager.emplace<TransformComponent>(entity);
-		transform.position = pos;
-		transform.rotation = glm::two_pi<float>() * rotation;
-		auto& physics = m_entity_manager.emplace<PhysicsComponent>(entity);
-		physics.velocity = glm::vec2(0,0);
-		physics.angular_velocity = 0.0f;
-
-		auto& mass_values = GetMassValues(shape);
-		shape.SetCenterOffset(mass_values.center_of_mass);
-
-		physics.mass = mass_values.mass;
-		physics.center_of_mass = mass_values.center_of_mass;
+		auto shape_id = m_shape_manager.CreateSharedShape(size, Shape::GenerateRandomImage(size, static_cast<u32>(rand())));
+		CreateBody(shape_id, pos, glm::two_pi<float>() * rotation);
 	};
 
 	create_entity({2, 0.5}, random());
@@ -78,6 +123,62 @@ void PhysicsSystem::Initialize() {
 	}
 }
 
+entt::entity PhysicsSystem::CreateBody(ShapeId shape_id, glm::vec2 position, float rotation) {
+	auto* shape_pointer = m_shape_manager.GetShape(shape_id);
+	if (!shape_pointer) {
+		std::cout << "ERROR: shape " << shape_id.Value() << " does not exist, no body created\n";
+		return entt::null;
+	}
+	auto& shape = *shape_pointer;
+	auto mass_values = GetMassValues(shape);
+	if (mass_values.mass <= 0.f) {
+		std::cout << "ERROR: shape " << shape_id.Value() << " has no solid pixels, no body created\n";
+		return entt::null;
+	}
+
+	auto entity = m_entity_manager.create();
+	m_entity_manager.emplace<ShapeId>(entity, shape_id);
+
+	auto& transform = m_entity_manager.emplace<TransformComponent>(entity);
+	transform.position = position;
+	transform.rotation = rotation;
+	auto& physics = m_entity_manager.emplace<PhysicsComponent>(entity);
+	physics.velocity = glm::vec2(0,0);
+	physics.angular_velocity = 0.0f;
+
+	shape.SetCenterOffset(mass_values.center_of_mass);
+
+	physics.mass = mass_values.mass;
+	physics.inertia = mass_values.inertia;
+	physics.center_of_mass = mass_values.center_of_mass;
+
+	return entity;
+}
+
+void PhysicsSystem::SetPlanes(std::vector<Plane> planes) {
+	m_planes = std::move(planes);
+}
+
+const std::vector<Plane>& PhysicsSystem::GetPlanes() const {
+	return m_planes;
+}
+
+const PhysicsTimings& PhysicsSystem::GetTimings() const {
+	return m_timings;
+}
+
+void PhysicsSystem::SetBroadphase(BroadphaseType type) {
+	m_broadphase_type = type;
+	m_broadphase = Broadphase::Create(type);
+	for (auto entity : m_entity_manager.view<StaticBodyComponent>()) {
+		OnTerrainTileLoaded(entity);
+	}
+}
+
+BroadphaseType PhysicsSystem::GetBroadphaseType() const {
+	return m_broadphase_type;
+}
+
 void PhysicsSystem::Update(float deltatime) {
 	//m_update_timer += deltatime;
 	//constexpr float update_time = 1.f / 100.f;
@@ -93,42 +194,96 @@ void PhysicsSystem::Update(float deltatime) {
 	//dt = glm::min(dt, 1.f/100.0f);
 	m_debug_drawing.Clear();
 
+	auto phase_start = std::chrono::steady_clock::now();
+	auto end_phase = [&phase_start](float& phase_time, std::string_view zone_name) {
+		auto now = std::chrono::steady_clock::now();
+		phase_time = std::chrono::duration<float, std::milli>(now - phase_start).count();
+		Profiler::RecordZone(zone_name, phase_start, now);
+		phase_start = now;
+	};
+
 	{
+		if (m_terrain.HasSource()) {
+			std::vector<glm::vec2> body_positions;
+			for (auto&& [entity, transform, physics] : m_entity_manager.view<TransformComponent, PhysicsComponent>().each()) {
+				body_positions.push_back(transform.position);
+			}
+			m_terrain.StreamAround(body_positions);
+		}
+
+		// Bodies stay in the broadphase between steps, static ones from when they are loaded
 		auto view = m_entity_manager.view<TransformComponent, PhysicsComponent, ShapeId>().each();
 		for (auto iter = view.begin(); iter != view.end(); ++iter) {
 			auto [entity, transform, physics, shape_id] = *iter;
-			auto& shape = *m_shape_manager.GetShape(shape_id);
-			m_broadphase->AddDynamic(entity, transform, shape);
+			auto* shape = m_shape_manager.GetShape(shape_id);
+			if (!shape) {
+				// Its shape was deleted, so it no longer collides
+				m_broadphase->Remove(entity);
+				continue;
+			}
+			m_broadphase->UpdateDynamic(entity, transform, *shape);
 		}
+		end_phase(m_timings.broadphase_insert, "PhysicsSystem::BroadphaseInsert");
 
 		auto& intersections = m_broadphase->GetPotentiallyIntersections();
+		m_timings.num_pairs = static_cast<u32>(intersections.size());
+		end_phase(m_timings.broadphase_pairs, "PhysicsSystem::BroadphasePairs");
+
+		u32 num_samples = 0;
+		u32 num_culled_pairs = 0;
+
 		for (auto& intersection : intersections) {
 			auto entity_left = intersection.first;
 			auto entity_right = intersection.second;
 
-			auto [transform_left, physics_left, shape_id_left] =
-				m_entity_manager.get<TransformComponent, PhysicsComponent, ShapeId>(entity_left);
-			auto& shape_left = *m_shape_manager.GetShape(shape_id_left);
+			// Static bodies have no PhysicsComponent, their transform is at the shape corner
+			auto [transform_left, shape_id_left] = m_entity_manager.get<TransformComponent, ShapeId>(entity_left);
+			auto* physics_left = m_entity_manager.try_get<PhysicsComponent>(entity_left);
+			auto [transform_right, shape_id_right] = m_entity_manager.get<TransformComponent, ShapeId>(entity_right);
+			auto* physics_right = m_entity_manager.try_get<PhysicsComponent>(entity_right);
+			// Static entities are removed before their shapes are deleted, so this is only a guard
+			auto* shape_left_pointer = m_shape_manager.GetShape(shape_id_left);
+			auto* shape_right_pointer = m_shape_manager.GetShape(shape_id_right);
+			if (!shape_left_pointer || !shape_right_pointer) {
+				continue;
+			}
+			auto& shape_left = *shape_left_pointer;
 			auto& sdf_left = shape_left.GetSdf();
-
-
-			auto [transform_right, physics_right, shape_id_right] =
-				m_entity_manager.get<TransformComponent, PhysicsComponent, ShapeId>(entity_right);
-			auto& shape_right = *m_shape_manager.GetShape(shape_id_right);
+			auto& shape_right = *shape_right_pointer;
 			auto& sdf_right = shape_right.GetSdf();
 
-			// do box-box collision first
-
 			auto rot_left = transform_left.CalculateRotationMatrix();
 			auto rot_right = transform_right.CalculateRotationMatrix();
 			auto inv_rot_left = glm::transpose(rot_left);
 			auto inv_rot_right = glm::transpose(rot_right);
 
-			glm::vec2 shape_corner_left = transform_left.position - rot_left * physics_left.center_of_mass;
-			glm::vec2 shape_corner_right = transform_right.position - rot_right * physics_right.center_of_mass;
+			glm::vec2 shape_corner_left = transform_left.position - (physics_left ? rot_left * physics_left->center_of_mass : glm::vec2(0.f));
+			glm::vec2 shape_corner_right = transform_right.position - (physics_right ? rot_right * physics_right->center_of_mass : glm::vec2(0.f));
+
+			// The bounding circles overlap, the boxes around the solid pixels are tighter and
+			// far cheaper than marching
+			auto box_left = CalculateSolidBox(shape_left, shape_corner_left, rot_left);
+			auto box_right = CalculateSolidBox(shape_right, shape_corner_right, rot_right);
+			if (!OrientedBoxesOverlap(box_left, box_right, c_PixelSizeMeters)) {
+				++num_culled_pairs;
+				continue;
+			}
 
 			glm::vec2 center = 0.5f * (transform_left.position + transform_right.position);
 			glm::vec2 diff = transform_left.position - transform_right.position;
+			if (!physics_left || !physics_right) {
+				// Static bodies are large, so the march starts at the body and the two contacts
+				// are spread along the static surface below it
+				const bool left_is_static = !physics_left;
+				auto& sdf_static = left_is_static ? sdf_left : sdf_right;
+				auto& rot_static = left_is_static ? rot_left : rot_right;
+				const glm::vec2 corner_static = left_is_static ? shape_corner_left : shape_corner_right;
+				center = left_is_static ? transform_right.position : transform_left.position;
+				diff = rot_static * sdf_static.GetDistanceAndGradient(glm::transpose(rot_static) * (center - corner_static)).second;
+				if (glm::dot(diff, diff) < 1e-12f) {
+					diff = glm::vec2(0.f, 1.f);
+				}
+			}
 			glm::vec2 tangent = glm::normalize(glm::vec2(diff.y, -diff.x));
 
 			auto size_left = shape_left.GetSizeInMeters();
@@ -139,9 +294,26 @@ void PhysicsSystem::Update(float deltatime) {
 				center + 0.2f * tangent,
 				center - 0.2f * tangent
 			};
+			// The steps shrink by 0.9, so the march moves at most 10 times the current step size.
+			// If either shape is further away than that it can not end inside both.
+			auto get_reach = [](float step_size) {
+				return (10.f * step_size + c_MarchSlackMeters) * c_PixelsPerMeter * c_SdfDistanceScale;
+			};
 			for (auto& march_pos : march_positions) {
 				float step_size = 0.2f * start_step_scale;
 
+				// The coarsest levels are small enough to stay in cache and reject some separated pairs
+				{
+					auto local_pos_left = (inv_rot_left * (march_pos - shape_corner_left));
+					auto local_pos_right = (inv_rot_right * (march_pos - shape_corner_right));
+					num_samples += 2;
+					const float reach = get_reach(step_size);
+					if (sdf_left.GetDistanceBound(local_pos_left, sdf_left.GetNumLevels() - 1) > reach
+						|| sdf_right.GetDistanceBound(local_pos_right, sdf_right.GetNumLevels() - 1) > reach) {
+						continue;
+					}
+				}
+
 				glm::vec2 prev_march_pos;
 				float distance;
 				glm::vec2 normal;
@@ -156,6 +328,15 @@ void PhysicsSystem::Update(float deltatime) {
 
 					auto [distance_left, local_gradient_left] = sdf_left.GetDistanceAndGradient(local_pos_left);
 					auto [distance_right, local_gradient_right] = sdf_right.GetDistanceAndGradient(local_pos_right);
+					num_samples += 2;
+
+					// Outside the image the distance is not in sdf units
+					const float reach = get_reach(step_size);
+					if ((distance_left > reach && sdf_left.IsInsideImage(local_pos_left))
+						|| (distance_right > reach && sdf_right.IsInsideImage(local_pos_right))) {
+						inside = false;
+						break;
+					}
 
 					if (distance_left > distance_right) {
 						distance = distance_left;
@@ -183,15 +364,33 @@ void PhysicsSystem::Update(float deltatime) {
 
 				if (inside) {
 					auto local_pos_left = (inv_rot_left * (march_pos - shape_corner_left));
-					constexpr float c_eps = c_PixelSizeMeters;
-					auto [_0, local_gradient_left] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(-c_eps, 0));
-					auto [_1, local_gradient_right] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(c_eps, 0));
-					auto [_2, local_gradient_up] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(0, c_eps));
-					auto [_3, local_gradient_down] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(0, -c_eps));
-
-					normal = inv_rot_left * (-normal) + local_gradient_left + local_gradient_right + local_gradient_up + local_gradient_down;
-					normal *= 1.0f / 5.0f;
+					const glm::vec2 march_normal = normal;
+
+					if (sdf_left.HasGradients()) {
+						// Precomputed unit average of the four taps below
+						normal = inv_rot_left * (-normal) + 4.f * sdf_left.GetSmoothedGradient(local_pos_left);
+					} else {
+						constexpr float c_eps = c_PixelSizeMeters;
+						auto [_0, local_gradient_left] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(-c_eps, 0));
+						auto [_1, local_gradient_right] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(c_eps, 0));
+						auto [_2, local_gradient_up] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(0, c_eps));
+						auto [_3, local_gradient_down] = sdf_left.GetDistanceAndGradient(local_pos_left + glm::vec2(0, -c_eps));
+						normal = inv_rot_left * (-normal) + local_gradient_left + local_gradient_right + local_gradient_up + local_gradient_down;
+					}
 					normal = rot_left * normal;
+					// Both branches give unit normals, so the solver weights them the same
+					const float normal_length = glm::length(normal);
+					normal = normal_length > 1e-6f ? normal / normal_length : march_normal;
+
+					// Overlapping static tiles each own the contacts inside their own area
+					auto outside_static_area = [&](entt::entity entity) {
+						auto* static_body = m_entity_manager.try_get<StaticBodyComponent>(entity);
+						return static_body && (glm::any(glm::lessThan(march_pos, static_body->contact_min))
+							|| glm::any(glm::greaterThanEqual(march_pos, static_body->contact_max)));
+					};
+					if (outside_static_area(entity_left) || outside_static_area(entity_right)) {
+						continue;
+					}
 
 					m_contacts.push_back(Contact{ entity_left, entity_right, march_pos, normal, 2.0f * glm::abs(distance) });
 
@@ -200,12 +399,19 @@ void PhysicsSystem::Update(float deltatime) {
 				}
 			}
 		}
+		m_timings.num_samples = num_samples;
+		m_timings.num_culled_pairs = num_culled_pairs;
+		end_phase(m_timings.narrowphase, "PhysicsSystem::Narrowphase");
 	}
 
 	auto view = m_entity_manager.view<TransformComponent, PhysicsComponent, ShapeId>().each();
 	for (auto iter = view.begin(); iter != view.end(); ++iter) {
 		auto [entity, transform, physics, shape_id] = *iter;
-		auto& shape = *m_shape_manager.GetShape(shape_id);
+		auto* shape_pointer = m_shape_manager.GetShape(shape_id);
+		if (!shape_pointer) {
+			continue;
+		}
+		auto& shape = *shape_pointer;
 
 		const auto size = shape.GetSizeInMeters();
 		const auto radius = size.x;
@@ -221,37 +427,32 @@ void PhysicsSystem::Update(float deltatime) {
 			float projected_center = glm::dot(transform.position, normal);
 			float point = projected_center - radius;
 			if (point <= origin) {
-				auto& usize = shape.GetSize();
-				glm::uvec2 i;
-				for (i.y = 0; i.y < usize.y; ++i.y) {
-					for (i.x = 0; i.x < usize.x; ++i.x) {
-						auto pixel = shape.GetPixelAt(i);
-						if (pixel != c_MaterialEmptySpace) {
-							const glm::vec2 local_pos = c_PixelSizeMeters * (glm::vec2(i) + 0.5f);
-							auto collision_pos = shape_corner + rotation * local_pos;
-
-							float projected = glm::dot(collision_pos, normal);
-							if (projected - c_PixelRadius <= origin) {
-								float overlap = origin - (projected - c_PixelRadius);
-								collision_pos -= normal * c_PixelRadius;
-
-								m_contacts.push_back(Contact{ entity, m_entity_manager.invalid_entity(), collision_pos, normal, overlap });
-								//m_debug_drawing.AddLine(collision_pos, collision_pos + normal);
-							}
-
-							//constexpr float bog = 0.25f * c_PixelSizeMeters;
-							//m_debug_drawing.AddLine(collision_pos + glm::vec2(bog, 0), collision_pos - glm::vec2(bog, 0));
-							//m_debug_drawing.AddLine(collision_pos + glm::vec2(0, bog), collision_pos - glm::vec2(0, bog));
-						}
+				// The deepest pixels are hull vertices, the ones between them on a flat side
+				// under the plane add nothing the two ends do not
+				for (auto& local_pos : shape.GetConvexHull()) {
+					auto collision_pos = shape_corner + rotation * local_pos;
+
+					float projected = glm::dot(collision_pos, normal);
+					if (projected - c_PixelRadius <= origin) {
+						float overlap = origin - (projected - c_PixelRadius);
+						collision_pos -= normal * c_PixelRadius;
+
+						m_contacts.push_back(Contact{ entity, m_entity_manager.invalid_entity(), collision_pos, normal, overlap });
+						//m_debug_drawing.AddLine(collision_pos, collision_pos + normal);
 					}
 				}
 			}
 		};
 
-		plane(glm::vec2(0,0), glm::vec2(0,1));
-		plane(glm::vec2(0,0), glm::vec2(1,0));
-		plane(glm::vec2(6,0), glm::vec2(-1,0));
+		for (auto& world_plane : m_planes) {
+			plane(world_plane.position, world_plane.normal);
+		}
 	}
+	end_phase(m_timings.plane_contacts, "PhysicsSystem::PlaneContacts");
+
+	ReduceContacts();
+	m_timings.num_contacts = static_cast<u32>(m_contacts.size());
+	end_phase(m_timings.contact_reduction, "PhysicsSystem::ContactReduction");
 
 	constexpr int c_MaxSolverIterations = 5;
 	for (int i = 0; i < c_MaxSolverIterations; ++i) {
@@ -262,14 +463,18 @@ void PhysicsSystem::Update(float deltatime) {
 			auto* physics_right = m_entity_manager.try_get<PhysicsComponent>(contact.entity_right);
 			auto* transform_right = m_entity_manager.try_get<TransformComponent>(contact.entity_right);
 
+			const auto tangent = glm::vec2(contact.normal.y, -contact.normal.x);
 			float normal_mass = 0.f;
+			float tangent_mass = 0.f;
 			glm::vec2 relative_vel(0.f);
 			if (physics_left) {
-				normal_mass += 1.0f / physics_left->mass;
+				normal_mass += CalculateInverseMassAt(*physics_left, *transform_left, contact.normal, contact.position);
+				tangent_mass += CalculateInverseMassAt(*physics_left, *transform_left, tangent, contact.position);
 				relative_vel += CalculateVelocityAt(*physics_left, *transform_left, contact.position);
 			}
 			if (physics_right) {
-				normal_mass += 1.0f / physics_right->mass;
+				normal_mass += CalculateInverseMassAt(*physics_right, *transform_right, contact.normal, contact.position);
+				tangent_mass += CalculateInverseMassAt(*physics_right, *transform_right, tangent, contact.position);
 				relative_vel -= CalculateVelocityAt(*physics_right, *transform_right, contact.position);
 			}
 
@@ -282,9 +487,8 @@ void PhysicsSystem::Update(float deltatime) {
 			contact.previous_impulse = glm::min(impulse + old_impulse, 0.f);
 			impulse = contact.previous_impulse - old_impulse;
 
-			const auto tangent = glm::vec2(contact.normal.y, -contact.normal.x);
 			const float tangent_vel = glm::dot(tangent, relative_vel);
-			auto tangent_impulse = tangent_vel / normal_mass;
+			auto tangent_impulse = tangent_vel / tangent_mass;
 
 			constexpr float c_Friction = 0.2f;
 			float old_tangent_impulse = contact.previous_tangent_impulse;
@@ -303,6 +507,7 @@ void PhysicsSystem::Update(float deltatime) {
 	}
 
 	m_contacts.clear();
+	end_phase(m_timings.solver, "PhysicsSystem::Solver");
 
 	for (auto &&[entity, transform, physics] : m_entity_manager.view<TransformComponent, PhysicsComponent>().each()) {
 		//m_debug_drawing.AddCross(transform.position, 0.1f);
@@ -315,34 +520,172 @@ void PhysicsSystem::Update(float deltatime) {
 
 		physics.velocity.y -= 9.82 * dt;
 	}
+	end_phase(m_timings.integration, "PhysicsSystem::Integration");
 }
 
-MassValues& PhysicsSystem::GetMassValues(const Shape& shape) {
-	if (auto iter = m_mass_values.find(shape.GetId()); iter != m_mass_values.end()) {
-		return iter->second;
-	} else {
-		auto& size = shape.GetSize();
-
-		MassValues result;
-
-		glm::uvec2 i;
-		for (i.y = 0; i.y < size.y; ++i.y) {
-			for (i.x = 0; i.x < size.x; ++i.x) {
-				auto pixel = shape.GetPixelAt(i);
-				if (pixel != c_MaterialEmptySpace) {
-					constexpr float density = 100.0f;
-					float mass = c_PixelAreaMeters * density;
-					glm::vec2 current_pos = c_PixelSizeMeters * (glm::vec2(i) + 0.5f);
-					result.center_of_mass += mass * current_pos;
-					result.mass += mass;
-				}
+void PhysicsSystem::OnTerrainTileLoaded(entt::entity entity) {
+	auto [transform, shape_id] = m_entity_manager.get<TransformComponent, ShapeId>(entity);
+	auto* shape = m_shape_manager.GetShape(shape_id);
+	if (!shape) {
+		return;
+	}
+	auto& bounds = shape->GetSolidBounds();
+	const glm::vec2 solid_center = transform.position + shape->GetSolidCenter();
+	m_broadphase->AddStatic(entity, Aabb{ solid_center + bounds.box_min, solid_center + bounds.box_max });
+}
+
+void PhysicsSystem::OnTerrainTileUnloaded(entt::entity entity) {
+	m_broadphase->Remove(entity);
+}
+
+void PhysicsSystem::OnBodyDestroyed(entt::registry&, entt::entity entity) {
+	m_broadphase->Remove(entity);
+}
+
+void PhysicsSystem::ReduceContacts() {
+	const auto plane_entity = m_entity_manager.invalid_entity();
+	auto same_manifold = [plane_entity](const Contact& a, const Contact& b) {
+		// Plane contacts of a body only differ by normal
+		return a.entity_left == b.entity_left && a.entity_right == b.entity_right
+			&& (a.entity_right != plane_entity || a.normal == b.normal);
+	};
+
+	// Group the contacts of each manifold, keeping the manifolds and the contacts within them in
+	// the order they were found. Contacts that are already grouped keep their order.
+	constexpr u32 c_NoManifold = ~0u;
+	m_manifolds.clear();
+	m_manifold_by_pair.clear();
+	m_contact_manifolds.resize(m_contacts.size());
+	bool grouped = true;
+	for (u32 i = 0; i < m_contacts.size(); ++i) {
+		const Contact& contact = m_contacts[i];
+		const u64 pair = (u64(entt::to_integral(contact.entity_left)) << 32) | entt::to_integral(contact.entity_right);
+		const auto it = m_manifold_by_pair.try_emplace(pair, c_NoManifold).first;
+		u32 manifold = it->second;
+		u32 last = c_NoManifold;
+		while (manifold != c_NoManifold && !same_manifold(m_contacts[m_manifolds[manifold].first_contact], contact)) {
+			last = manifold;
+			manifold = m_manifolds[manifold].next;
+		}
+		if (manifold == c_NoManifold) {
+			manifold = static_cast<u32>(m_manifolds.size());
+			(last == c_NoManifold ? it->second : m_manifolds[last].next) = manifold;
+			m_manifolds.push_back(ContactManifold{ i, 0, c_NoManifold });
+		}
+		grouped = grouped && (i == 0 || manifold == m_contact_manifolds[i - 1] || manifold + 1 == m_manifolds.size());
+		m_contact_manifolds[i] = manifold;
+		++m_manifolds[manifold].num_contacts;
+	}
+	if (!grouped) {
+		u32 offset = 0;
+		for (auto& manifold : m_manifolds) {
+			manifold.first_contact = offset;
+			offset += manifold.num_contacts;
+		}
+		m_grouped_contacts.resize(m_contacts.size());
+		for (u32 i = 0; i < m_contacts.size(); ++i) {
+			m_grouped_contacts[m_manifolds[m_contact_manifolds[i]].first_contact++] = m_contacts[i];
+		}
+		m_contacts.swap(m_grouped_contacts);
+	}
+
+	size_t num_kept = 0;
+	for (size_t begin = 0; begin < m_contacts.size();) {
+		size_t end = begin + 1;
+		while (end < m_contacts.size() && same_manifold(m_contacts[begin], m_contacts[end])) {
+			++end;
+		}
+
+		if (end - begin <= c_MaxManifoldContacts) {
+			for (size_t i = begin; i < end; ++i) {
+				m_contacts[num_kept++] = m_contacts[i];
+			}
+			begin = end;
+			continue;
+		}
+
+		const glm::vec2 normal = m_contacts[begin].normal;
+		const glm::vec2 tangent(normal.y, -normal.x);
+		auto along = [&](size_t i) {
+			return glm::dot(m_contacts[i].position, tangent);
+		};
+		std::array<size_t, c_MaxManifoldContacts> kept;
+		kept.fill(begin);
+		for (size_t i = begin; i < end; ++i) {
+			if (m_contacts[i].intersection_depth > m_contacts[kept[0]].intersection_depth) {
+				kept[0] = i;
+			}
+			if (along(i) < along(kept[1])) {
+				kept[1] = i;
+			}
+			if (along(i) > along(kept[2])) {
+				kept[2] = i;
+			}
+		}
+		float best_gap = -1.f;
+		for (size_t i = begin; i < end; ++i) {
+			float gap = glm::min(glm::abs(along(i) - along(kept[0])),
+				glm::min(glm::abs(along(i) - along(kept[1])), glm::abs(along(i) - along(kept[2]))));
+			if (gap > best_gap) {
+				best_gap = gap;
+				kept[3] = i;
 			}
 		}
-		result.center_of_mass /= result.mass;
 
-		{
-			auto iter = m_mass_values.emplace(shape.GetId(), std::move(result));
-			return iter.first->second;
+		// Keep them in the order they were found, the deepest and an outermost one can be the same
+		std::sort(kept.begin(), kept.end());
+		const size_t num_unique = std::unique(kept.begin(), kept.end()) - kept.begin();
+		for (size_t i = 0; i < num_unique; ++i) {
+			m_contacts[num_kept++] = m_contacts[kept[i]];
+		}
+		begin = end;
+	}
+	m_contacts.resize(num_kept);
+}
+
+MassValues PhysicsSystem::GetMassValues(const Shape& shape) const {
+	// The shape keeps the moments of its occupancy up to date, so this is cheap even for large shapes
+	MassValues result;
+	result.mass = shape.GetNumSolidPixels() * c_PixelAreaMeters * c_Density;
+	result.center_of_mass = shape.GetSolidCenter();
+	result.inertia = shape.GetSolidSecondMoment() * c_Density;
+	return result;
+}
+
+void PhysicsSystem::OnShapeEdited(const ShapeEdit& edit) {
+	auto& shape = *m_shape_manager.GetShape(edit.shape_id);
+
+	// Static aabbs are fitted to the solid pixels, so edits can grow or shrink them. Static
+	// bodies are placed at their shape corner and keep a zero center offset.
+	bool is_static = false;
+	for (auto&& [entity, static_body, shape_id] : m_entity_manager.view<StaticBodyComponent, ShapeId>().each()) {
+		if (shape_id == edit.shape_id) {
+			is_static = true;
+			OnTerrainTileLoaded(entity);
+		}
+	}
+	if (is_static) {
+		return;
+	}
+
+	auto mass_values = GetMassValues(shape);
+	// Bodies keep their last center of mass, mass and inertia when everything is erased. They
+	// make no contacts while empty, but stay safe to divide by when impulses are applied.
+	const bool erased = mass_values.mass <= 0.f;
+	if (erased) {
+		mass_values.center_of_mass = shape.GetCenterOffset();
+	}
+	shape.SetCenterOffset(mass_values.center_of_mass);
+
+	// Keep the shape corner of bodies in place when the center of mass moves
+	for (auto&& [entity, transform, physics, shape_id] : m_entity_manager.view<TransformComponent, PhysicsComponent, ShapeId>().each()) {
+		if (shape_id == edit.shape_id) {
+			transform.position += transform.CalculateRotationMatrix() * (mass_values.center_of_mass - physics.center_of_mass);
+			physics.center_of_mass = mass_values.center_of_mass;
+			if (!erased) {
+				physics.mass = mass_values.mass;
+				physics.inertia = mass_values.inertia;
+			}
 		}
 	}
 }
@@ -1,23 +1,50 @@
 #pragma once
 
 #include <memory>
-#include <robin_hood/robin_hood.h>
 #include <glm/vec2.hpp>
+#include <robin_hood/robin_hood.h>
+#include "engine/Broadphase.hpp"
 #include "engine/System.hpp"
 #include "ecs/EntityManager.hpp"
 #include "engine/shape/ShapeId.hpp"
+#include "util/IntTypes.hpp"
 
 class SystemManager;
 class ShapeManager;
 class DebugDrawing;
-class Broadphase;
-class Input;
+class Terrain;
+struct ShapeEdit;
 
 struct MassValues {
 	// Relative to shape corner
 	glm::vec2 center_of_mass{};
 	float mass = 0.f;
-	//float inertia;
+	// Around the center of mass
+	float inertia = 0.f;
+};
+
+struct Plane {
+	glm::vec2 position;
+	glm::vec2 normal;
+};
+
+/// Time spent in each phase of the last PhysicsSystem::Update, in milliseconds
+struct PhysicsTimings {
+	float broadphase_insert = 0.f;
+	float broadphase_pairs = 0.f;
+	float narrowphase = 0.f;
+	float plane_contacts = 0.f;
+	float contact_reduction = 0.f;
+	float solver = 0.f;
+	float integration = 0.f;
+
+	u32 num_pairs = 0;
+	// Pairs whose solid boxes were apart, so they were never marched
+	u32 num_culled_pairs = 0;
+	// After the reduction
+	u32 num_contacts = 0;
+	// Sdf samples taken by the narrowphase march
+	u32 num_samples = 0;
 };
 
 struct Contact {
@@ -35,16 +62,37 @@ public:
 	PhysicsSystem(SystemManager& system_manager);
 	~PhysicsSystem();
 
+	entt::entity CreateBody(ShapeId shape_id, glm::vec2 position, float rotation = 0.f);
+
+	void SetPlanes(std::vector<Plane> planes);
+	const std::vector<Plane>& GetPlanes() const;
+
+	const PhysicsTimings& GetTimings() const;
+
+	/// Replaces the broadphase, bodies are added to the new one on the next update
+	void SetBroadphase(BroadphaseType type);
+	BroadphaseType GetBroadphaseType() const;
+
 private:
 	void Initialize();
 	void Update(float dt);
 
-	MassValues& GetMassValues(const Shape& shape);
+	/// Keeps at most c_MaxManifoldContacts of the contacts between the same two bodies, or the
+	/// same body and plane: the deepest one, the two outermost along the contact tangent and the
+	/// one furthest from those. Contacts are first grouped by manifold, in the order each
+	/// manifold was first found, so they do not need to be contiguous.
+	void ReduceContacts();
+	MassValues GetMassValues(const Shape& shape) const;
+	void OnShapeEdited(const ShapeEdit& edit);
+	void OnTerrainTileLoaded(entt::entity entity);
+	void OnBodyDestroyed(entt::registry& registry, entt::entity entity);
+	void OnTerrainTileUnloaded(entt::entity entity);
 
 	EntityManager& m_entity_manager;
 	ShapeManager& m_shape_manager;
 	DebugDrawing& m_debug_drawing;
-	Input& m_input;
+	Terrain& m_terrain;
+	BroadphaseType m_broadphase_type = BroadphaseType::Grid;
 	std::unique_ptr<Broadphase> m_broadphase;
 
 	float m_update_timer = 0.f;
@@ -52,6 +100,18 @@ private:
 	entt::entity m_dragging_entity;
 
 	std::vector<Contact> m_contacts;
+	/// Scratch for grouping the contacts in ReduceContacts
+	struct ContactManifold {
+		u32 first_contact;
+		u32 num_contacts;
+		/// Next manifold of the same pair, plane manifolds of a body share the pair
+		u32 next;
+	};
+	std::vector<ContactManifold> m_manifolds;
+	std::vector<u32> m_contact_manifolds;
+	std::vector<Contact> m_grouped_contacts;
+	robin_hood::unordered_flat_map<u64, u32> m_manifold_by_pair;
+	std::vector<Plane> m_planes;
 
-	robin_hood::unordered_flat_map<ShapeId, MassValues> m_mass_values;
+	PhysicsTimings m_timings;
 };
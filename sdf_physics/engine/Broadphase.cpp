@@ -1,82 +1,51 @@
 #include "Broadphase.hpp"
 
-#include "SystemManager.hpp"
-#include "shape/ShapeManager.hpp"
-#include "ecs/EntityManager.hpp"
-#include "ecs/components/Transform.hpp"
-#include "util/Aabb.hpp"
+#include <glm/common.hpp>
 #include <glm/geometric.hpp>
 #include <glm/gtx/norm.hpp>
-
-constexpr float c_CellSize = 8.0f;
-
-glm::ivec2 ToCellSpace(glm::vec2 pos) {
-	return glm::ivec2(glm::floor(pos / c_CellSize));
+#include <entt/entity/entity.hpp>
+#include "GridBroadphase.hpp"
+#include "TreeBroadphase.hpp"
+#include "shape/Shape.hpp"
+#include "util/ParallelFor.hpp"
+#include "util/RadixSort.hpp"
+
+std::unique_ptr<Broadphase> Broadphase::Create(BroadphaseType type) {
+	switch (type) {
+	case BroadphaseType::Tree:
+		return std::make_unique<TreeBroadphase>();
+	case BroadphaseType::Grid:
+	default:
+		return std::make_unique<GridBroadphase>();
+	}
 }
 
-Broadphase::Broadphase(SystemManager& system_manager)
-	: m_shape_manager{ system_manager.Get<ShapeManager>() }
-	, m_entity_manager{ system_manager.Get<EntityManager>() }
-{
-
+float Broadphase::GetBoundingRadius(const Shape& shape) {
+	return shape.GetSolidBounds().radius;
 }
 
-void Broadphase::AddDynamic(entt::entity entity, const TransformComponent& transform, const Shape& shape) {
-	auto size = shape.GetSizeInMeters();
-	float radius = 0.5f * glm::length(size);
-	glm::vec2 min = transform.position - glm::vec2(radius);
-	glm::vec2 max = transform.position + glm::vec2(radius);
-
-	glm::ivec2 start = ToCellSpace(min);
-	glm::ivec2 end = ToCellSpace(max);
-	glm::ivec2 index;
-	for (index.y = start.y; index.y <= end.y; ++index.y) {
-		for (index.x = start.x; index.x <= end.x; ++index.x) {
-			auto [iter, added_new] = m_cells.try_emplace(index);
-			iter->second.dynamic.push_back(entity);
-		}
-	}
+bool Broadphase::CirclesOverlap(glm::vec2 center_a, float radius_a, glm::vec2 center_b, float radius_b) {
+	float radius_sum = radius_a + radius_b;
+	return glm::length2(center_a - center_b) <= radius_sum * radius_sum;
 }
 
-const std::vector<std::pair<entt::entity, entt::entity>>& Broadphase::GetPotentiallyIntersections() {
-	m_intersections_cache.clear();
-
-	for (auto& [key, cell] : m_cells) {
-		auto& dynamic = cell.dynamic;
-		for (auto iter_left = dynamic.begin(); iter_left != dynamic.end(); ++iter_left) {
-			auto entity_left = *iter_left;
-			const auto& [transform_left, shape_id_left] = m_entity_manager.get<TransformComponent, ShapeId>(entity_left);
-			auto& shape_left = *m_shape_manager.GetShape(shape_id_left);
-
-			auto size_left = shape_left.GetSizeInMeters();
-			float radius_left = 0.5f * glm::length(size_left);
-
-			for (auto iter_right = iter_left + 1; iter_right != dynamic.end(); ++iter_right) {
-				auto entity_right = *iter_right;
-				const auto& [transform_right, shape_id_right] = m_entity_manager.get<TransformComponent, ShapeId>(entity_right);
-				auto& shape_right = *m_shape_manager.GetShape(shape_id_right);
+bool Broadphase::CircleOverlapsAabb(glm::vec2 center, float radius, const Aabb& aabb) {
+	glm::vec2 closest = glm::clamp(center, aabb.min, aabb.max);
+	return glm::length2(center - closest) <= radius * radius;
+}
 
-				auto size_right = shape_right.GetSizeInMeters();
-				float radius_right = 0.5f * glm::length(size_right);
+u64 Broadphase::PackEntityPair(entt::entity a, entt::entity b) {
+	const u64 left = entt::to_integral(a);
+	const u64 right = entt::to_integral(b);
+	return left < right ? (left << 32) | right : (right << 32) | left;
+}
 
-				float radius_sum = radius_left + radius_right;
-				float distance2 = glm::length2(transform_left.position - transform_right.position);
-				if (distance2 <= radius_sum * radius_sum) {
-					if (entity_left < entity_right) {
-						m_intersections_cache.push_back({ entity_left, entity_right });
-					} else {
-						m_intersections_cache.push_back({ entity_right, entity_left });
-					}
-				}
-			}
+void Broadphase::SortIntersections(std::vector<u64>& keys, std::vector<u64>& scratch, std::vector<std::pair<entt::entity, entt::entity>>& intersections) {
+	RadixSort(keys, scratch);
+	intersections.resize(keys.size());
+	ParallelFor(static_cast<u32>(keys.size()), 1 << 14, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; ++i) {
+			intersections[i] = { entt::entity(keys[i] >> 32), entt::entity(static_cast<u32>(keys[i])) };
 		}
-
-		cell.dynamic.clear();
-	}
-
-	std::sort(m_intersections_cache.begin(), m_intersections_cache.end());
-	auto unique_iter = std::unique(m_intersections_cache.begin(), m_intersections_cache.end());
-	m_intersections_cache.erase(unique_iter, m_intersections_cache.end());
-
-	return m_intersections_cache;
+	});
 }
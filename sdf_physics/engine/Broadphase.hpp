@@ -1,45 +1,47 @@
 #pragma once
 
-#include <robin_hood/robin_hood.h>
+#include <memory>
+#include <utility>
+#include <vector>
 #include <glm/vec2.hpp>
 #include <entt/fwd.hpp>
+#include "util/Aabb.hpp"
+#include "util/IntTypes.hpp"
 
-class EntityManager;
-class SystemManager;
-class ShapeManager;
 class Shape;
 struct TransformComponent;
 
-namespace std {
-	template <>
-	struct hash<glm::ivec2> {
-		size_t operator()(const glm::ivec2& x) const{
-			union {
-				size_t hashed;
-				glm::ivec2 v;
-			};
-			v = x;
-			return hashed;
-		}
-	};
-}
+enum class BroadphaseType {
+	/// GridBroadphase, uniform grid of 8 m cells
+	Grid,
+	/// TreeBroadphase, dynamic aabb trees
+	Tree,
+};
 
+/// Finds the pairs of entities whose bounds overlap. Bodies are bounded by a circle around their
+/// position and static entities by an aabb, static entities are never paired with each other.
 class Broadphase {
 public:
-	Broadphase(SystemManager&);
-
-	void AddDynamic(entt::entity entity, const TransformComponent& transform, const Shape& shape);
-
-	const std::vector<std::pair<entt::entity, entt::entity>>& GetPotentiallyIntersections();
-private:
-	struct Cell {
-		std::vector<entt::entity> dynamic;
-		//std::vector<entt::entity> static;
-	};
-
-	ShapeManager& m_shape_manager;
-	EntityManager& m_entity_manager;
-
-	robin_hood::unordered_node_map<glm::ivec2, Cell> m_cells;
-	std::vector<std::pair<entt::entity, entt::entity>> m_intersections_cache;
-};
\ No newline at end of file
+	static std::unique_ptr<Broadphase> Create(BroadphaseType type);
+
+	virtual ~Broadphase() {}
+
+	/// Adds entity or moves it to its new bounding circle. Called every step for every body.
+	virtual void UpdateDynamic(entt::entity entity, const TransformComponent& transform, const Shape& shape) = 0;
+	/// Static entities never move
+	virtual void AddStatic(entt::entity entity, const Aabb& aabb) = 0;
+	/// Removes a dynamic or static entity and all of its pairs
+	virtual void Remove(entt::entity entity) = 0;
+
+	/// Pairs with overlapping bounds, sorted and without duplicates
+	virtual const std::vector<std::pair<entt::entity, entt::entity>>& GetPotentiallyIntersections() = 0;
+protected:
+	/// Around the center of mass, only as large as the solid pixels need
+	static float GetBoundingRadius(const Shape& shape);
+	static bool CirclesOverlap(glm::vec2 center_a, float radius_a, glm::vec2 center_b, float radius_b);
+	static bool CircleOverlapsAabb(glm::vec2 center, float radius, const Aabb& aabb);
+	/// Smaller entity in the high bits, so packed pairs sort like the pairs themselves
+	static u64 PackEntityPair(entt::entity a, entt::entity b);
+	/// Radix sorts keys of PackEntityPair and unpacks them into intersections
+	static void SortIntersections(std::vector<u64>& keys, std::vector<u64>& scratch, std::vector<std::pair<entt::entity, entt::entity>>& intersections);
+};
@@ -1,27 +1,22 @@
 #include "Engine.hpp"
 
 #include "engine/SystemManager.hpp"
-#include "engine/shape/ShapeManager.hpp"
-#include "ecs/systems/PhysicsSystem.hpp"
 #include "Window.hpp"
 #include "Input.hpp"
 #include "graphics/Renderer.hpp"
-#include "graphics/DebugDrawing.hpp"
+#include "engine/shape/ShapeManager.hpp"
+#include "util/Profiler.hpp"
 
 Engine::Engine() {
-	m_system_manager.Add<EntityManager>();
-	m_system_manager.Add<DebugDrawing>();
-	m_system_manager.Add<ShapeManager>();
-	m_system_manager.Add<PhysicsSystem>(m_system_manager);
-
-	m_system_manager.Add<Window>(m_system_manager, 1280, 720);
-	m_system_manager.Add<Graphics::Renderer>(m_system_manager);
+	auto& system_manager = m_simulation.GetSystemManager();
+	system_manager.Add<Window>(system_manager, 1280, 720);
+	system_manager.Add<Graphics::Renderer>(system_manager);
 
 	//m_frame_limiter.SetFramerate(10.f);
 }
 
 bool Engine::IsRunning() const {
-	return m_running && !m_system_manager.Get<Window>().ShouldClose();
+	return m_running && !m_simulation.GetSystemManager().Get<Window>().ShouldClose();
 }
 
 void Engine::StopRunning() {
@@ -31,15 +26,16 @@ void Engine::StopRunning() {
 void Engine::Initialize() {
 	srand(time(nullptr));
 
-	m_system_manager.Initialize();
+	m_simulation.Initialize();
 }
 
 void Engine::Update(float deltatime) {
 	{
 		static Camera camera;
-		auto& renderer = m_system_manager.Get<Graphics::Renderer>();
-		auto& input = m_system_manager.Get<Input>();
-		auto& window = m_system_manager.Get<Window>();
+		auto& system_manager = m_simulation.GetSystemManager();
+		auto& renderer = system_manager.Get<Graphics::Renderer>();
+		auto& input = system_manager.Get<Input>();
+		auto& window = system_manager.Get<Window>();
 
 		glm::vec2 window_size = glm::vec2(window.GetWindowSize());
 
@@ -56,9 +52,18 @@ void Engine::Update(float deltatime) {
 		camera.position -= normalized_center_offset * (zoom_change-1.0f) * camera.zoom;
 
 		renderer.SetCamera(camera);
+
+		if (input.Has(ClientAction::DebugDumpProfile)) {
+			if (Profiler::WriteChromeTrace("profile_trace.json")) {
+				std::cout << "Wrote profile_trace.json\n";
+			}
+		}
+		if (input.Has(ClientAction::DebugDumpShapeMemory)) {
+			system_manager.Get<ShapeManager>().WriteMemoryReport(std::cout);
+		}
 	}
 
-	m_system_manager.Update(deltatime);
+	m_simulation.Update(deltatime);
 
 	//m_frame_limiter.Limit();
 }
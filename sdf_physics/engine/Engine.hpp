@@ -1,6 +1,8 @@
 #pragma once
 
-#include "SystemManager.hpp"
+#include <atomic>
+
+#include "Simulation.hpp"
 #include "util/FrameLimiter.hpp"
 
 class Engine {
@@ -14,7 +16,7 @@ public:
 	void Update(float deltatime);
 
 private:
-	SystemManager m_system_manager;
+	Simulation m_simulation;
 	FrameLimiter m_frame_limiter;
 	std::atomic_bool m_running = true;
 };
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "GridBroadphase.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <entt/entity/entity.hpp>
+#include "ecs/components/Transform.hpp"
+#include "util/ParallelFor.hpp"
+#include <glm/common.hpp>
+
+constexpr float c_CellSize = 8.0f;
+/// Pairs per ParallelFor batch when testing and collecting pairs
+constexpr u32 c_PairBatchSize = 4096;
+
+glm::ivec2 ToCellSpace(glm::vec2 pos) {
+	return glm::ivec2(glm::floor(pos / c_CellSize));
+}
+
+bool InCellRange(glm::ivec2 index, glm::ivec2 min, glm::ivec2 max) {
+	return glm::all(glm::greaterThanEqual(index, min)) && glm::all(glm::lessThanEqual(index, max));
+}
+
+void GridBroadphase::UpdateDynamic(entt::entity entity, const TransformComponent& transform, const Shape& shape) {
+	const float radius = GetBoundingRadius(shape);
+
+	auto iter = m_proxy_by_entity.find(entity);
+	const bool added = iter == m_proxy_by_entity.end();
+	const u32 index = added ? CreateProxy(entity, false) : iter->second;
+	auto& proxy = m_proxies[index];
+	if (!added && proxy.position == transform.position && proxy.radius == radius) {
+		return;
+	}
+	proxy.position = transform.position;
+	proxy.radius = radius;
+	if (!proxy.moved) {
+		proxy.moved = true;
+		m_moved.push_back(index);
+	}
+	MoveToCells(index, ToCellSpace(transform.position - glm::vec2(radius)), ToCellSpace(transform.position + glm::vec2(radius)));
+}
+
+void GridBroadphase::AddStatic(entt::entity entity, const Aabb& aabb) {
+	if (m_proxy_by_entity.contains(entity)) {
+		Remove(entity);
+	}
+	const u32 index = CreateProxy(entity, true);
+	auto& proxy = m_proxies[index];
+	proxy.aabb = aabb;
+	// Its new pairs are tested with the moved ones
+	proxy.moved = true;
+	m_moved.push_back(index);
+	MoveToCells(index, ToCellSpace(aabb.min), ToCellSpace(aabb.max));
+}
+
+void GridBroadphase::Remove(entt::entity entity) {
+	auto iter = m_proxy_by_entity.find(entity);
+	if (iter == m_proxy_by_entity.end()) {
+		return;
+	}
+	const u32 index = iter->second;
+	m_proxy_by_entity.erase(iter);
+	MoveToCells(index, glm::ivec2(0), glm::ivec2(-1));
+	m_proxies[index] = Proxy{ entt::null };
+	m_free_proxies.push_back(index);
+}
+
+const std::vector<std::pair<entt::entity, entt::entity>>& GridBroadphase::GetPotentiallyIntersections() {
+	const u32 num_pairs = static_cast<u32>(m_pairs.size());
+	if (!m_moved.empty()) {
+		std::atomic<bool> changed = false;
+		ParallelFor(num_pairs, c_PairBatchSize, [&](u32 begin, u32 end) {
+			bool batch_changed = false;
+			for (u32 i = begin; i < end; ++i) {
+				auto& pair = m_pairs[i];
+				auto& a = m_proxies[static_cast<u32>(pair.key >> 32)];
+				auto& b = m_proxies[static_cast<u32>(pair.key)];
+				if (!a.moved && !b.moved) {
+					continue;
+				}
+				const bool overlapping = Overlaps(a, b);
+				batch_changed |= overlapping != pair.overlapping;
+				pair.overlapping = overlapping;
+			}
+			if (batch_changed) {
+				changed.store(true, std::memory_order_relaxed);
+			}
+		});
+		m_pairs_changed |= changed.load();
+		for (auto index : m_moved) {
+			m_proxies[index].moved = false;
+		}
+		m_moved.clear();
+	}
+
+	if (m_pairs_changed) {
+		m_pairs_changed = false;
+		// A single batch gets the whole range when ParallelFor runs inline
+		m_batch_keys.resize(std::max(1u, (num_pairs + c_PairBatchSize - 1) / c_PairBatchSize));
+		for (auto& keys : m_batch_keys) {
+			keys.clear();
+		}
+		ParallelFor(num_pairs, c_PairBatchSize, [&](u32 begin, u32 end) {
+			auto& keys = m_batch_keys[begin / c_PairBatchSize];
+			for (u32 i = begin; i < end; ++i) {
+				auto& pair = m_pairs[i];
+				if (pair.overlapping) {
+					keys.push_back(PackEntityPair(m_proxies[static_cast<u32>(pair.key >> 32)].entity, m_proxies[static_cast<u32>(pair.key)].entity));
+				}
+			}
+		});
+		m_sorted_keys.clear();
+		for (auto& keys : m_batch_keys) {
+			m_sorted_keys.insert(m_sorted_keys.end(), keys.begin(), keys.end());
+		}
+		SortIntersections(m_sorted_keys, m_sort_scratch, m_intersections_cache);
+	}
+
+	return m_intersections_cache;
+}
+
+u32 GridBroadphase::GetNumCells() const {
+	return static_cast<u32>(m_cells.size());
+}
+
+u32 GridBroadphase::CreateProxy(entt::entity entity, bool is_static) {
+	u32 index;
+	if (m_free_proxies.empty()) {
+		index = static_cast<u32>(m_proxies.size());
+		m_proxies.emplace_back();
+	} else {
+		index = m_free_proxies.back();
+		m_free_proxies.pop_back();
+	}
+	m_proxies[index] = Proxy{ entity };
+	m_proxies[index].is_static = is_static;
+	m_proxy_by_entity[entity] = index;
+	return index;
+}
+
+void GridBroadphase::MoveToCells(u32 proxy, glm::ivec2 cell_min, glm::ivec2 cell_max) {
+	const glm::ivec2 old_min = m_proxies[proxy].cell_min;
+	const glm::ivec2 old_max = m_proxies[proxy].cell_max;
+	if (old_min == cell_min && old_max == cell_max) {
+		return;
+	}
+
+	glm::ivec2 index;
+	for (index.y = old_min.y; index.y <= old_max.y; ++index.y) {
+		for (index.x = old_min.x; index.x <= old_max.x; ++index.x) {
+			if (!InCellRange(index, cell_min, cell_max)) {
+				RemoveFromCell(proxy, index);
+			}
+		}
+	}
+	for (index.y = cell_min.y; index.y <= cell_max.y; ++index.y) {
+		for (index.x = cell_min.x; index.x <= cell_max.x; ++index.x) {
+			if (!InCellRange(index, old_min, old_max)) {
+				AddToCell(proxy, index);
+			}
+		}
+	}
+	m_proxies[proxy].cell_min = cell_min;
+	m_proxies[proxy].cell_max = cell_max;
+}
+
+void GridBroadphase::AddToCell(u32 proxy, glm::ivec2 index) {
+	auto& cell = m_cells[index];
+	const bool is_static = m_proxies[proxy].is_static;
+	for (auto other : cell.dynamic) {
+		++FindOrAddPair(PairKey(proxy, other)).shared_cells;
+	}
+	if (is_static) {
+		cell.statics.push_back(proxy);
+		return;
+	}
+	for (auto other : cell.statics) {
+		++FindOrAddPair(PairKey(proxy, other)).shared_cells;
+	}
+	cell.dynamic.push_back(proxy);
+}
+
+void GridBroadphase::RemoveFromCell(u32 proxy, glm::ivec2 index) {
+	auto cell_iter = m_cells.find(index);
+	auto& cell = cell_iter->second;
+	const bool is_static = m_proxies[proxy].is_static;
+
+	auto& own_list = is_static ? cell.statics : cell.dynamic;
+	auto own = std::find(own_list.begin(), own_list.end(), proxy);
+	*own = own_list.back();
+	own_list.pop_back();
+
+	auto unpair = [this, proxy](u32 other) {
+		auto pair_iter = m_pair_by_key.find(PairKey(proxy, other));
+		const u32 pair = pair_iter->second;
+		if (--m_pairs[pair].shared_cells > 0) {
+			return;
+		}
+		// Swap with the last pair to keep the pairs dense
+		m_pairs_changed |= m_pairs[pair].overlapping;
+		m_pair_by_key.erase(pair_iter);
+		if (pair + 1 != m_pairs.size()) {
+			m_pairs[pair] = m_pairs.back();
+			m_pair_by_key.find(m_pairs[pair].key)->second = pair;
+		}
+		m_pairs.pop_back();
+	};
+	for (auto other : cell.dynamic) {
+		unpair(other);
+	}
+	if (!is_static) {
+		for (auto other : cell.statics) {
+			unpair(other);
+		}
+	}
+
+	if (cell.dynamic.empty() && cell.statics.empty()) {
+		m_cells.erase(cell_iter);
+	}
+}
+
+GridBroadphase::PairState& GridBroadphase::FindOrAddPair(u64 key) {
+	auto [iter, added] = m_pair_by_key.try_emplace(key, static_cast<u32>(m_pairs.size()));
+	if (added) {
+		m_pairs.push_back(PairState{ key });
+	}
+	return m_pairs[iter->second];
+}
+
+bool GridBroadphase::Overlaps(const Proxy& a, const Proxy& b) {
+	if (a.is_static || b.is_static) {
+		auto& body = a.is_static ? b : a;
+		return CircleOverlapsAabb(body.position, body.radius, a.is_static ? a.aabb : b.aabb);
+	}
+	return CirclesOverlap(a.position, a.radius, b.position, b.radius);
+}
+
+u64 GridBroadphase::PairKey(u32 a, u32 b) {
+	return a < b ? (u64(a) << 32) | b : (u64(b) << 32) | a;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <robin_hood/robin_hood.h>
+#include <glm/vec2.hpp>
+#include "Broadphase.hpp"
+#include "util/IntTypes.hpp"
+
+namespace std {
+	template <>
+	struct hash<glm::ivec2> {
+		size_t operator()(const glm::ivec2& x) const{
+			union {
+				size_t hashed;
+				glm::ivec2 v;
+			};
+			v = x;
+			return hashed;
+		}
+	};
+}
+
+/// Persistent uniform grid. Entities stay in their cells between steps and only move when the
+/// cells their bounds cover change, a cell is erased when its last entity leaves. Pairs of
+/// entities sharing a cell are kept with the number of cells they share, and only the pairs of
+/// entities that moved are tested again. Pairs are stored densely and tested in batches on the
+/// ParallelFor workers, which also collect the overlapping ones for a parallel radix sort.
+/// Large bodies cover many cells and small ones crowd into a few, so it suits bodies of
+/// similar size.
+class GridBroadphase final : public Broadphase {
+public:
+	/// Nothing is done if neither the position nor the shape size changed
+	void UpdateDynamic(entt::entity entity, const TransformComponent& transform, const Shape& shape) override;
+	void AddStatic(entt::entity entity, const Aabb& aabb) override;
+	void Remove(entt::entity entity) override;
+	const std::vector<std::pair<entt::entity, entt::entity>>& GetPotentiallyIntersections() override;
+
+	u32 GetNumCells() const;
+private:
+	struct Proxy {
+		entt::entity entity;
+		glm::vec2 position{};
+		float radius = 0.f;
+		Aabb aabb{};
+		/// Covered cells, empty while max < min
+		glm::ivec2 cell_min{ 0 };
+		glm::ivec2 cell_max{ -1 };
+		bool is_static = false;
+		bool moved = false;
+	};
+
+	struct Cell {
+		std::vector<u32> dynamic;
+		std::vector<u32> statics;
+	};
+
+	struct PairState {
+		u64 key = 0;
+		u32 shared_cells = 0;
+		bool overlapping = false;
+	};
+
+	u32 CreateProxy(entt::entity entity, bool is_static);
+	void MoveToCells(u32 proxy, glm::ivec2 cell_min, glm::ivec2 cell_max);
+	void AddToCell(u32 proxy, glm::ivec2 index);
+	void RemoveFromCell(u32 proxy, glm::ivec2 index);
+	PairState& FindOrAddPair(u64 key);
+	static bool Overlaps(const Proxy& a, const Proxy& b);
+	static u64 PairKey(u32 a, u32 b);
+
+	robin_hood::unordered_flat_map<glm::ivec2, Cell> m_cells;
+
+	std::vector<Proxy> m_proxies;
+	std::vector<u32> m_free_proxies;
+	robin_hood::unordered_flat_map<entt::entity, u32> m_proxy_by_entity;
+	std::vector<u32> m_moved;
+
+	/// Dense so batches of pairs can be tested on the worker threads
+	std::vector<PairState> m_pairs;
+	robin_hood::unordered_flat_map<u64, u32> m_pair_by_key;
+	bool m_pairs_changed = false;
+	/// Packed entity pairs found by each batch, concatenated in batch order
+	std::vector<std::vector<u64>> m_batch_keys;
+	std::vector<u64> m_sorted_keys;
+	std::vector<u64> m_sort_scratch;
+	std::vector<std::pair<entt::entity, entt::entity>> m_intersections_cache;
+};
@@ -0,0 +1,31 @@
+#include "Simulation.hpp"
+
+#include "engine/shape/ShapeManager.hpp"
+#include "ecs/EntityManager.hpp"
+#include "ecs/systems/PhysicsSystem.hpp"
+#include "engine/Terrain.hpp"
+#include "graphics/DebugDrawing.hpp"
+
+Simulation::Simulation() {
+	m_system_manager.Add<EntityManager>();
+	m_system_manager.Add<DebugDrawing>();
+	m_system_manager.Add<ShapeManager>(m_system_manager);
+	m_system_manager.Add<Terrain>(m_system_manager);
+	m_system_manager.Add<PhysicsSystem>(m_system_manager);
+}
+
+void Simulation::Initialize() {
+	m_system_manager.Initialize();
+}
+
+void Simulation::Update(float dt) {
+	m_system_manager.Update(dt);
+}
+
+SystemManager& Simulation::GetSystemManager() {
+	return m_system_manager;
+}
+
+const SystemManager& Simulation::GetSystemManager() const {
+	return m_system_manager;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "SystemManager.hpp"
+
+/// Headless core of the engine, owns the systems needed to step physics
+/// without a window or an OpenGL context.
+class Simulation {
+public:
+	Simulation();
+
+	void Initialize();
+	void Update(float dt);
+
+	SystemManager& GetSystemManager();
+	const SystemManager& GetSystemManager() const;
+
+private:
+	SystemManager m_system_manager;
+};
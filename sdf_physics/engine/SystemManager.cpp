@@ -1,5 +1,7 @@
 #include "SystemManager.hpp"
 
+#include "util/Profiler.hpp"
+
 SystemManager::SystemManager() {}
 
 SystemManager::~SystemManager() {}
@@ -17,5 +19,29 @@ void SystemManager::Initialize() {
 }
 
 void SystemManager::Update(float dt) {
-	m_on_update.publish(dt);
+	PROFILE_ZONE("SystemManager::Update");
+
+	if (!Profiler::IsEnabled()) {
+		m_on_update.publish(dt);
+		return;
+	}
+
+	size_t listener_index = 0;
+	auto listener_start = Profiler::Clock::now();
+	m_on_update.collect([&]() {
+		auto now = Profiler::Clock::now();
+		std::string_view name = "SystemManager::Update listener";
+		if (listener_index < m_update_listener_names.size() && !m_update_listener_names[listener_index].empty()) {
+			name = m_update_listener_names[listener_index];
+		}
+		Profiler::RecordZone(name, listener_start, now);
+		++listener_index;
+		listener_start = now;
+	}, dt);
+}
+
+void SystemManager::NameUpdateListeners(std::string_view name) {
+	while (m_update_listener_names.size() < m_on_update.size()) {
+		m_update_listener_names.push_back(name);
+	}
 }
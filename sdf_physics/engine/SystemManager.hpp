@@ -8,6 +8,8 @@
 #include "System.hpp"
 
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 class SystemManager {
 public:
@@ -20,10 +22,21 @@ public:
 	template <class TSystem, class...Args>
 	TSystem& Add(Args&&...args) {
 		constexpr u32 id = entt::internal::type_hash<TSystem>((int)0);
+
+		// Update listeners connected while constructing are profiled under the system's name
+		NameUpdateListeners(m_adding_system_names.empty() ? "" : m_adding_system_names.back());
+		m_adding_system_names.push_back(entt::type_name<TSystem>::value());
 		auto [iter, addedNew] = m_systems.emplace(id, std::make_unique<TSystem>(std::forward<Args>(args)...));
+		NameUpdateListeners(m_adding_system_names.back());
+		m_adding_system_names.pop_back();
+
 		if (!addedNew) {
 			std::cout << "ERROR: added duplicate system\n";
+#if defined(_MSC_VER)
 			__debugbreak();
+#else
+			__builtin_trap();
+#endif
 		}
 		return *static_cast<TSystem*>(iter->second.get());
 	}
@@ -50,8 +63,13 @@ public:
 	void Update(float dt);
 
 private:
+	void NameUpdateListeners(std::string_view name);
+
 	robin_hood::unordered_flat_map<u32, std::unique_ptr<System>> m_systems;
 
+	std::vector<std::string_view> m_update_listener_names;
+	std::vector<std::string_view> m_adding_system_names;
+
 	entt::sigh<void()> m_on_initialize;
 	entt::sigh<void(float)> m_on_update;
 };
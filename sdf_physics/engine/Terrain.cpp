@@ -0,0 +1,209 @@
+#include "Terrain.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <glm/common.hpp>
+#include "engine/SystemManager.hpp"
+#include "engine/shape/ShapeManager.hpp"
+#include "engine/shape/ShapeMetadata.hpp"
+#include "ecs/EntityManager.hpp"
+#include "ecs/components/StaticBody.hpp"
+#include "ecs/components/Transform.hpp"
+#include "util/Profiler.hpp"
+
+Terrain::Terrain(SystemManager& system_manager)
+	: m_shape_manager{ system_manager.Get<ShapeManager>() }
+	, m_entity_manager{ system_manager.Get<EntityManager>() }
+{
+	m_shape_manager.OnShapeCooked().connect<&Terrain::OnShapeCooked>(this);
+}
+
+void Terrain::SetSource(TerrainSource source, TerrainSettings settings) {
+	if (settings.tile_size == 0) {
+		std::cout << "ERROR: terrain tile size must be positive\n";
+		return;
+	}
+	UnloadAll();
+	m_source = std::move(source);
+	m_settings = settings;
+}
+
+void Terrain::SetImage(glm::uvec2 size, std::vector<u8> image, TerrainSettings settings) {
+	if (image.size() != size_t(size.x) * size.y) {
+		std::cout << "ERROR: terrain image has " << image.size() << " pixels, expected " << size.x << "x" << size.y << "\n";
+		return;
+	}
+	auto level = std::make_shared<const std::vector<u8>>(std::move(image));
+	SetSource([level, size](glm::ivec2 min, glm::uvec2 rect_size, std::vector<u8>& pixels) {
+		const glm::ivec2 begin = glm::max(min, glm::ivec2(0));
+		const glm::ivec2 end = glm::min(min + glm::ivec2(rect_size), glm::ivec2(size));
+		for (i32 y = begin.y; y < end.y; ++y) {
+			std::memcpy(&pixels[(begin.x - min.x) + size_t(y - min.y) * rect_size.x],
+				&(*level)[begin.x + size_t(y) * size.x], std::max(end.x - begin.x, 0));
+		}
+	}, settings);
+}
+
+bool Terrain::HasSource() const {
+	return static_cast<bool>(m_source);
+}
+
+const TerrainSettings& Terrain::GetSettings() const {
+	return m_settings;
+}
+
+void Terrain::StreamAround(const std::vector<glm::vec2>& positions) {
+	if (!m_source) {
+		return;
+	}
+	PROFILE_ZONE("Terrain::StreamAround");
+
+	const float tile_meters = m_settings.tile_size * c_PixelSizeMeters;
+	auto to_tiles = [tile_meters](float distance) {
+		return static_cast<i32>(glm::ceil(distance / tile_meters));
+	};
+	const i32 required_tiles = to_tiles(m_settings.required_distance);
+	const i32 load_tiles = glm::max(required_tiles, to_tiles(m_settings.load_distance));
+	const i32 keep_tiles = glm::max(load_tiles, to_tiles(m_settings.unload_distance));
+
+	// Bodies are usually many to a tile, so the neighbourhoods are only walked once per tile
+	robin_hood::unordered_flat_set<glm::ivec2, TileIndexHash> occupied;
+	for (auto& position : positions) {
+		occupied.insert(GetTileIndex(position));
+	}
+
+	robin_hood::unordered_flat_set<glm::ivec2, TileIndexHash> keep;
+	std::vector<ShapeId> required;
+	for (auto& center : occupied) {
+		glm::ivec2 offset;
+		for (offset.y = -keep_tiles; offset.y <= keep_tiles; ++offset.y) {
+			for (offset.x = -keep_tiles; offset.x <= keep_tiles; ++offset.x) {
+				const glm::ivec2 index = center + offset;
+				const i32 tiles_away = glm::max(glm::abs(offset.x), glm::abs(offset.y));
+				if (auto iter = m_tiles.find(index); iter != m_tiles.end()) {
+					if (iter->second.loading && tiles_away <= required_tiles) {
+						required.push_back(iter->second.shape_id);
+					}
+					keep.insert(index);
+					continue;
+				}
+				if (tiles_away > load_tiles) {
+					continue;
+				}
+
+				auto source = m_source;
+				auto settings = m_settings;
+				auto id = m_shape_manager.CreateShapeAsync([source, settings, index]() {
+					const u32 size = settings.tile_size + 2 * settings.apron;
+					std::vector<u8> pixels(size_t(size) * size, c_MaterialEmptySpace);
+					source(index * i32(settings.tile_size) - i32(settings.apron), glm::uvec2(size), pixels);
+					if (std::all_of(pixels.begin(), pixels.end(), [](u8 pixel) { return pixel == c_MaterialEmptySpace; })) {
+						// Stands in for an empty tile without building its sdf, dropped when published
+						return Shape(glm::uvec2(1), std::vector<u8>(1, c_MaterialEmptySpace));
+					}
+					return Shape(glm::uvec2(size), std::move(pixels), settings.sdf_settings);
+				});
+				m_tiles.emplace(index, Tile{ id, entt::null, true });
+				m_tiles_by_shape.emplace(id, index);
+				++m_num_loading;
+				keep.insert(index);
+				if (tiles_away <= required_tiles) {
+					required.push_back(id);
+				}
+			}
+		}
+	}
+
+	std::vector<glm::ivec2> unload;
+	for (auto& [index, tile] : m_tiles) {
+		if (!keep.contains(index)) {
+			unload.push_back(index);
+		}
+	}
+	for (auto& index : unload) {
+		Unload(m_tiles.at(index));
+		m_tiles.erase(index);
+	}
+
+	for (auto id : required) {
+		m_shape_manager.FinishCooking(id);
+	}
+}
+
+void Terrain::FinishLoading() {
+	m_shape_manager.FinishCooking();
+}
+
+void Terrain::UnloadAll() {
+	for (auto& [index, tile] : m_tiles) {
+		Unload(tile);
+	}
+	m_tiles.clear();
+}
+
+u32 Terrain::GetNumLoadedTiles() const {
+	return static_cast<u32>(m_tiles.size()) - m_num_loading;
+}
+
+u32 Terrain::GetNumLoadingTiles() const {
+	return m_num_loading;
+}
+
+entt::sink<void(entt::entity)> Terrain::OnTileLoaded() {
+	return { m_on_tile_loaded };
+}
+
+entt::sink<void(entt::entity)> Terrain::OnTileUnloaded() {
+	return { m_on_tile_unloaded };
+}
+
+void Terrain::OnShapeCooked(ShapeId id) {
+	auto iter = m_tiles_by_shape.find(id);
+	if (iter == m_tiles_by_shape.end()) {
+		return;
+	}
+	const glm::ivec2 index = iter->second;
+	auto& tile = m_tiles.at(index);
+	tile.loading = false;
+	--m_num_loading;
+
+	if (m_shape_manager.GetShape(id)->GetNumSolidPixels() == 0) {
+		m_tiles_by_shape.erase(iter);
+		m_shape_manager.DeleteShape(id);
+		tile.shape_id = ShapeId();
+		return;
+	}
+
+	const float tile_meters = m_settings.tile_size * c_PixelSizeMeters;
+	const glm::vec2 contact_min = m_settings.origin + tile_meters * glm::vec2(index);
+
+	tile.entity = m_entity_manager.create();
+	m_entity_manager.emplace<ShapeId>(tile.entity, id);
+	auto& transform = m_entity_manager.emplace<TransformComponent>(tile.entity);
+	transform.position = contact_min - c_PixelSizeMeters * glm::vec2(m_settings.apron);
+	m_entity_manager.emplace<StaticBodyComponent>(tile.entity, contact_min, contact_min + glm::vec2(tile_meters));
+
+	m_on_tile_loaded.publish(tile.entity);
+}
+
+void Terrain::Unload(Tile& tile) {
+	if (tile.entity != entt::null) {
+		m_on_tile_unloaded.publish(tile.entity);
+		m_entity_manager.destroy(tile.entity);
+	}
+	if (tile.shape_id.IsValid()) {
+		// Drops the result of tiles that are still cooking
+		m_tiles_by_shape.erase(tile.shape_id);
+		m_shape_manager.DeleteShape(tile.shape_id);
+	}
+	if (tile.loading) {
+		--m_num_loading;
+	}
+}
+
+glm::ivec2 Terrain::GetTileIndex(glm::vec2 position) const {
+	const float tile_meters = m_settings.tile_size * c_PixelSizeMeters;
+	return glm::ivec2(glm::floor((position - m_settings.origin) / tile_meters));
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <entt/fwd.hpp>
+#include <entt/signal/sigh.hpp>
+#include <glm/vec2.hpp>
+#include <robin_hood/robin_hood.h>
+#include "engine/System.hpp"
+#include "engine/shape/Shape.hpp"
+#include "engine/shape/ShapeId.hpp"
+
+class SystemManager;
+class ShapeManager;
+class EntityManager;
+
+/// Fills pixels, row major with size, with the materials of the level starting at level pixel min.
+/// Called from background threads. Can reach outside the level, where it should be empty.
+using TerrainSource = std::function<void(glm::ivec2 min, glm::uvec2 size, std::vector<u8>& pixels)>;
+
+struct TerrainSettings {
+	/// World position of the corner of level pixel (0, 0)
+	glm::vec2 origin{};
+	/// Pixels per tile side, tile (x, y) starts at level pixel tile_size * (x, y)
+	u32 tile_size = 256;
+	/// Pixels of the neighbouring tiles included around each tile, so distances near
+	/// a tile edge still see the surface across it
+	u32 apron = 16;
+	/// Tiles within load_distance of a body are loaded in the background, the ones further than
+	/// unload_distance from every body unloaded. Tiles within required_distance are waited for,
+	/// so bodies never reach a tile that is not there. All are rounded up to whole tiles.
+	float required_distance = 1.f;
+	float load_distance = 4.f;
+	float unload_distance = 8.f;
+	SdfSettings sdf_settings;
+};
+
+/// Static level stored as fixed size tiles, each a shape with its own sdf. Tiles are cooked in
+/// the background when a body comes near them and deleted when every body has left. A loaded
+/// tile is an entity with a TransformComponent at its shape corner, a ShapeId and a
+/// StaticBodyComponent, tiles without solid pixels get no entity.
+class Terrain final : public System {
+public:
+	Terrain(SystemManager& system_manager);
+
+	/// Unloads every tile and streams tiles from source from now on
+	void SetSource(TerrainSource source, TerrainSettings settings = {});
+	/// Level from an image, row major with y up, empty outside it
+	void SetImage(glm::uvec2 size, std::vector<u8> image, TerrainSettings settings = {});
+	bool HasSource() const;
+	const TerrainSettings& GetSettings() const;
+
+	/// Starts loading the tiles near positions, waits for the ones closest to them and unloads
+	/// the tiles far from all of them
+	void StreamAround(const std::vector<glm::vec2>& positions);
+	/// Waits for every tile that is loading, their entities exist afterwards
+	void FinishLoading();
+	void UnloadAll();
+
+	u32 GetNumLoadedTiles() const;
+	u32 GetNumLoadingTiles() const;
+
+	/// Published when a tile entity has been created
+	entt::sink<void(entt::entity)> OnTileLoaded();
+	/// Published before a tile entity is destroyed
+	entt::sink<void(entt::entity)> OnTileUnloaded();
+private:
+	struct Tile {
+		ShapeId shape_id;
+		entt::entity entity;
+		bool loading = true;
+	};
+
+	struct TileIndexHash {
+		size_t operator()(glm::ivec2 index) const {
+			return robin_hood::hash_int((u64(u32(index.x)) << 32) | u32(index.y));
+		}
+	};
+
+	void OnShapeCooked(ShapeId id);
+	void Unload(Tile& tile);
+	glm::ivec2 GetTileIndex(glm::vec2 position) const;
+
+	ShapeManager& m_shape_manager;
+	EntityManager& m_entity_manager;
+
+	TerrainSource m_source;
+	TerrainSettings m_settings;
+
+	robin_hood::unordered_flat_map<glm::ivec2, Tile, TileIndexHash> m_tiles;
+	robin_hood::unordered_flat_map<ShapeId, glm::ivec2> m_tiles_by_shape;
+	u32 m_num_loading = 0;
+
+	entt::sigh<void(entt::entity)> m_on_tile_loaded;
+	entt::sigh<void(entt::entity)> m_on_tile_unloaded;
+};
@@ -0,0 +1,216 @@
+#include "TreeBroadphase.hpp"
+
+#include <algorithm>
+#include <entt/entity/entity.hpp>
+#include "ecs/components/Transform.hpp"
+
+/// Room to move before a body is reinserted. Larger margins reinsert less often but give
+/// more candidates to test, which costs more in crowded piles of small bodies.
+constexpr float c_TreeMargin = 0.1f;
+
+namespace {
+
+bool FatOverlaps(const Aabb& a, const Aabb& b) {
+	return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+}
+
+}
+
+TreeBroadphase::TreeBroadphase()
+	: m_dynamic_tree{ c_TreeMargin }
+	, m_static_tree{ 0.f }
+{}
+
+void TreeBroadphase::UpdateDynamic(entt::entity entity, const TransformComponent& transform, const Shape& shape) {
+	const float radius = GetBoundingRadius(shape);
+
+	auto iter = m_proxy_by_entity.find(entity);
+	const bool added = iter == m_proxy_by_entity.end();
+	const u32 index = added ? CreateProxy(entity, false) : iter->second;
+	auto& proxy = m_proxies[index];
+	if (!added && proxy.position == transform.position && proxy.radius == radius) {
+		return;
+	}
+	proxy.position = transform.position;
+	proxy.radius = radius;
+
+	const Aabb aabb{ transform.position - glm::vec2(radius), transform.position + glm::vec2(radius) };
+	bool reinserted = true;
+	if (added) {
+		proxy.leaf = m_dynamic_tree.Insert(aabb, index);
+	} else {
+		reinserted = m_dynamic_tree.Move(proxy.leaf, aabb);
+	}
+	MarkMoved(index, reinserted);
+}
+
+void TreeBroadphase::AddStatic(entt::entity entity, const Aabb& aabb) {
+	if (m_proxy_by_entity.contains(entity)) {
+		Remove(entity);
+	}
+	const u32 index = CreateProxy(entity, true);
+	auto& proxy = m_proxies[index];
+	proxy.aabb = aabb;
+	proxy.leaf = m_static_tree.Insert(aabb, index);
+	MarkMoved(index, true);
+}
+
+void TreeBroadphase::Remove(entt::entity entity) {
+	auto iter = m_proxy_by_entity.find(entity);
+	if (iter == m_proxy_by_entity.end()) {
+		return;
+	}
+	const u32 index = iter->second;
+	m_proxy_by_entity.erase(iter);
+	auto& proxy = m_proxies[index];
+	(proxy.is_static ? m_static_tree : m_dynamic_tree).Remove(proxy.leaf);
+	proxy.entity = entt::null;
+	proxy.leaf = AabbTree::c_NullNode;
+	m_removed_proxies.push_back(index);
+}
+
+const std::vector<std::pair<entt::entity, entt::entity>>& TreeBroadphase::GetPotentiallyIntersections() {
+	if (!m_removed_proxies.empty()) {
+		for (auto iter = m_candidates.begin(); iter != m_candidates.end();) {
+			auto& a = m_proxies[static_cast<u32>(iter->first >> 32)];
+			auto& b = m_proxies[static_cast<u32>(iter->first)];
+			if (a.leaf == AabbTree::c_NullNode || b.leaf == AabbTree::c_NullNode) {
+				m_pairs_changed |= iter->second;
+				iter = m_candidates.erase(iter);
+			} else {
+				++iter;
+			}
+		}
+		m_free_proxies.insert(m_free_proxies.end(), m_removed_proxies.begin(), m_removed_proxies.end());
+		m_removed_proxies.clear();
+	}
+
+	if (!m_moved.empty()) {
+		FindCandidates();
+
+		// Fattened aabbs only change when reinserted, which also counts as moved
+		for (auto iter = m_candidates.begin(); iter != m_candidates.end();) {
+			auto& a = m_proxies[static_cast<u32>(iter->first >> 32)];
+			auto& b = m_proxies[static_cast<u32>(iter->first)];
+			if (!m_retest_all && !a.moved && !b.moved) {
+				++iter;
+				continue;
+			}
+			if (!FatOverlaps(GetFatAabb(a), GetFatAabb(b))) {
+				m_pairs_changed |= iter->second;
+				iter = m_candidates.erase(iter);
+				continue;
+			}
+			const bool overlapping = Overlaps(a, b);
+			m_pairs_changed |= overlapping != iter->second;
+			iter->second = overlapping;
+			++iter;
+		}
+
+		for (auto index : m_moved) {
+			m_proxies[index].moved = false;
+			m_proxies[index].reinserted = false;
+		}
+		m_moved.clear();
+		m_retest_all = false;
+	}
+
+	if (m_pairs_changed) {
+		m_pairs_changed = false;
+		m_sorted_keys.clear();
+		for (auto& [key, overlapping] : m_candidates) {
+			if (overlapping) {
+				m_sorted_keys.push_back(PackEntityPair(m_proxies[static_cast<u32>(key >> 32)].entity, m_proxies[static_cast<u32>(key)].entity));
+			}
+		}
+		SortIntersections(m_sorted_keys, m_sort_scratch, m_intersections_cache);
+	}
+
+	return m_intersections_cache;
+}
+
+const AabbTree& TreeBroadphase::GetDynamicTree() const {
+	return m_dynamic_tree;
+}
+
+u32 TreeBroadphase::CreateProxy(entt::entity entity, bool is_static) {
+	u32 index;
+	if (m_free_proxies.empty()) {
+		index = static_cast<u32>(m_proxies.size());
+		m_proxies.emplace_back();
+	} else {
+		index = m_free_proxies.back();
+		m_free_proxies.pop_back();
+	}
+	m_proxies[index] = Proxy{ entity };
+	m_proxies[index].is_static = is_static;
+	m_proxy_by_entity[entity] = index;
+	return index;
+}
+
+void TreeBroadphase::MarkMoved(u32 proxy, bool reinserted) {
+	auto& moved = m_proxies[proxy];
+	if (!moved.moved) {
+		moved.moved = true;
+		m_moved.push_back(proxy);
+	}
+	if (reinserted && !moved.reinserted) {
+		moved.reinserted = true;
+		m_reinserted.push_back(proxy);
+	}
+}
+
+void TreeBroadphase::FindCandidates() {
+	if (m_reinserted.empty()) {
+		return;
+	}
+
+	// Pairing the trees against each other beats a query per leaf when most leaves moved
+	const u32 num_leaves = m_dynamic_tree.GetNumLeaves() + m_static_tree.GetNumLeaves();
+	if (4 * m_reinserted.size() > num_leaves) {
+		m_query_pairs.clear();
+		m_dynamic_tree.QueryPairs(m_query_pairs);
+		m_dynamic_tree.QueryPairs(m_static_tree, m_query_pairs);
+		for (auto [a, b] : m_query_pairs) {
+			m_candidates.try_emplace(PairKey(a, b), false);
+		}
+		m_retest_all = true;
+		m_reinserted.clear();
+		return;
+	}
+
+	for (auto index : m_reinserted) {
+		auto& proxy = m_proxies[index];
+		if (proxy.leaf == AabbTree::c_NullNode) {
+			continue;
+		}
+		const Aabb fat_aabb = GetFatAabb(proxy);
+		m_query_results.clear();
+		m_dynamic_tree.Query(fat_aabb, m_query_results);
+		if (!proxy.is_static) {
+			m_static_tree.Query(fat_aabb, m_query_results);
+		}
+		for (auto other : m_query_results) {
+			if (other != index) {
+				m_candidates.try_emplace(PairKey(index, other), false);
+			}
+		}
+	}
+	m_reinserted.clear();
+}
+
+const Aabb& TreeBroadphase::GetFatAabb(const Proxy& proxy) const {
+	return (proxy.is_static ? m_static_tree : m_dynamic_tree).GetFatAabb(proxy.leaf);
+}
+
+bool TreeBroadphase::Overlaps(const Proxy& a, const Proxy& b) const {
+	if (a.is_static || b.is_static) {
+		auto& body = a.is_static ? b : a;
+		return CircleOverlapsAabb(body.position, body.radius, a.is_static ? a.aabb : b.aabb);
+	}
+	return CirclesOverlap(a.position, a.radius, b.position, b.radius);
+}
+
+u64 TreeBroadphase::PairKey(u32 a, u32 b) {
+	return a < b ? (u64(a) << 32) | b : (u64(b) << 32) | a;
+}
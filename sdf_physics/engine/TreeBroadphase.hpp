@@ -0,0 +1,63 @@
+#pragma once
+
+#include <robin_hood/robin_hood.h>
+#include "Broadphase.hpp"
+#include "util/AabbTree.hpp"
+#include "util/IntTypes.hpp"
+
+/// Bodies in one dynamic aabb tree and static entities in another. A body is only reinserted
+/// when it leaves its fattened aabb, and only reinserted leaves look for new candidate pairs,
+/// or both trees are paired against each other when most leaves were. Candidates are kept
+/// between steps and their exact bounds tested again when one of them moved.
+/// Handles bodies of very different sizes, where a grid has no good cell size.
+class TreeBroadphase final : public Broadphase {
+public:
+	TreeBroadphase();
+
+	void UpdateDynamic(entt::entity entity, const TransformComponent& transform, const Shape& shape) override;
+	void AddStatic(entt::entity entity, const Aabb& aabb) override;
+	void Remove(entt::entity entity) override;
+	const std::vector<std::pair<entt::entity, entt::entity>>& GetPotentiallyIntersections() override;
+
+	const AabbTree& GetDynamicTree() const;
+private:
+	struct Proxy {
+		entt::entity entity;
+		glm::vec2 position{};
+		float radius = 0.f;
+		Aabb aabb{};
+		u32 leaf = AabbTree::c_NullNode;
+		bool is_static = false;
+		bool moved = false;
+		bool reinserted = false;
+	};
+
+	u32 CreateProxy(entt::entity entity, bool is_static);
+	void MarkMoved(u32 proxy, bool reinserted);
+	/// Adds the candidates of the reinserted proxies, or of all when most were reinserted
+	void FindCandidates();
+	const Aabb& GetFatAabb(const Proxy& proxy) const;
+	bool Overlaps(const Proxy& a, const Proxy& b) const;
+	static u64 PairKey(u32 a, u32 b);
+
+	std::vector<Proxy> m_proxies;
+	std::vector<u32> m_free_proxies;
+	/// Freed once their candidates are gone
+	std::vector<u32> m_removed_proxies;
+	robin_hood::unordered_flat_map<entt::entity, u32> m_proxy_by_entity;
+	std::vector<u32> m_moved;
+	std::vector<u32> m_reinserted;
+
+	AabbTree m_dynamic_tree;
+	AabbTree m_static_tree;
+
+	/// Proxies with overlapping fattened aabbs, and whether their exact bounds overlap
+	robin_hood::unordered_flat_map<u64, bool> m_candidates;
+	bool m_retest_all = false;
+	bool m_pairs_changed = false;
+	std::vector<u32> m_query_results;
+	std::vector<std::pair<u32, u32>> m_query_pairs;
+	std::vector<u64> m_sorted_keys;
+	std::vector<u64> m_sort_scratch;
+	std::vector<std::pair<entt::entity, entt::entity>> m_intersections_cache;
+};
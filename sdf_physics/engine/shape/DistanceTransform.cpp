@@ -0,0 +1,93 @@
+#include "DistanceTransform.hpp"
+
+#include <algorithm>
+
+#include "Shape.hpp"
+#include "util/ParallelFor.hpp"
+
+void ComputeSquaredDistances(const std::vector<u8>& image, glm::uvec2 size, bool seeds_are_solid, std::vector<i32>& squared_distances) {
+	const i64 width = size.x;
+	const i64 height = size.y;
+	const i64 infinity = width + height;
+	squared_distances.resize(width * height);
+
+	bool has_seed = false;
+	for (i64 i = 0; i < width * height && !has_seed; ++i) {
+		has_seed = (image[i] != c_MaterialEmptySpace) == seeds_are_solid;
+	}
+	if (!has_seed) {
+		std::fill(squared_distances.begin(), squared_distances.end(), c_NoSeedSquaredDistance);
+		return;
+	}
+
+	// Column pass, distance to the closest seed in the same column. Batches of whole columns
+	// are swept row by row so the inner loop stays contiguous.
+	std::vector<i32> column_distances(width * height);
+	ParallelFor(size.x, 64, [&](u32 begin, u32 end) {
+		for (i64 x = begin; x < end; ++x) {
+			bool seed = (image[x] != c_MaterialEmptySpace) == seeds_are_solid;
+			column_distances[x] = seed ? 0 : static_cast<i32>(infinity);
+		}
+		for (i64 y = 1; y < height; ++y) {
+			const u8* image_row = &image[y * width];
+			i32* row = &column_distances[y * width];
+			const i32* previous_row = &column_distances[(y - 1) * width];
+			for (i64 x = begin; x < end; ++x) {
+				bool seed = (image_row[x] != c_MaterialEmptySpace) == seeds_are_solid;
+				row[x] = seed ? 0 : previous_row[x] + 1;
+			}
+		}
+		for (i64 y = height - 2; y >= 0; --y) {
+			i32* row = &column_distances[y * width];
+			const i32* next_row = &column_distances[(y + 1) * width];
+			for (i64 x = begin; x < end; ++x) {
+				if (next_row[x] < row[x]) {
+					row[x] = next_row[x] + 1;
+				}
+			}
+		}
+	});
+
+	// Row pass, lower envelope of the parabolas (x - i)^2 + g(i)^2
+	ParallelFor(size.y, 16, [&](u32 begin, u32 end) {
+		std::vector<i64> envelope_sites(width);
+		std::vector<i64> envelope_starts(width);
+		for (i64 y = begin; y < end; ++y) {
+			const i32* g = &column_distances[y * width];
+			i32* out = &squared_distances[y * width];
+
+			auto f = [g](i64 x, i64 i) {
+				return (x - i) * (x - i) + i64(g[i]) * g[i];
+			};
+			auto separation = [g](i64 i, i64 u) {
+				return (u * u - i * i + i64(g[u]) * g[u] - i64(g[i]) * g[i]) / (2 * (u - i));
+			};
+
+			i64 q = 0;
+			envelope_sites[0] = 0;
+			envelope_starts[0] = 0;
+			for (i64 u = 1; u < width; ++u) {
+				while (q >= 0 && f(envelope_starts[q], envelope_sites[q]) > f(envelope_starts[q], u)) {
+					--q;
+				}
+				if (q < 0) {
+					q = 0;
+					envelope_sites[0] = u;
+				} else {
+					i64 w = 1 + separation(envelope_sites[q], u);
+					if (w < width) {
+						++q;
+						envelope_sites[q] = u;
+						envelope_starts[q] = w;
+					}
+				}
+			}
+			for (i64 x = width - 1; x >= 0; --x) {
+				out[x] = static_cast<i32>(f(x, envelope_sites[q]));
+				if (x == envelope_starts[q]) {
+					--q;
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+#include <glm/vec2.hpp>
+
+#include "util/IntTypes.hpp"
+
+/// Squared distance used when the image has no seed pixels at all
+constexpr i32 c_NoSeedSquaredDistance = 2 * 9999 * 9999;
+
+/// Exact squared euclidean distance from every pixel to the closest seed pixel, seeds are the
+/// pixels where (image[i] != c_MaterialEmptySpace) == seeds_are_solid. Separable in the style of
+/// Meijster et al., the column and the row pass are split across the worker threads.
+void ComputeSquaredDistances(const std::vector<u8>& image, glm::uvec2 size, bool seeds_are_solid, std::vector<i32>& squared_distances);
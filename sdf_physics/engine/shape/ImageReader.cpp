@@ -0,0 +1,605 @@
+#include "ImageReader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+
+namespace {
+
+constexpr u32 c_MaxImageSize = 1u << 16;
+
+u32 ReadBigEndian(const u8* bytes) {
+	return (u32(bytes[0]) << 24) | (u32(bytes[1]) << 16) | (u32(bytes[2]) << 8) | u32(bytes[3]);
+}
+
+/// Canonical huffman code from code lengths, the first c_FastBits of a code are a table lookup
+class HuffmanTable {
+public:
+	static constexpr u32 c_FastBits = 9;
+
+	bool Build(const u8* lengths, u32 count) {
+		std::array<u16, 16> num_codes{};
+		for (u32 i = 0; i < count; ++i) {
+			++num_codes[lengths[i]];
+		}
+		num_codes[0] = 0;
+
+		// Over subscribed sets are invalid, incomplete ones are allowed for single code trees
+		i32 left = 1;
+		for (u32 length = 1; length < 16; ++length) {
+			left = (left << 1) - num_codes[length];
+			if (left < 0) {
+				return false;
+			}
+		}
+
+		std::array<u16, 16> offsets{};
+		for (u32 length = 1; length < 15; ++length) {
+			offsets[length + 1] = offsets[length] + num_codes[length];
+		}
+		m_symbols.assign(count, 0);
+		for (u32 i = 0; i < count; ++i) {
+			if (lengths[i] != 0) {
+				m_symbols[offsets[lengths[i]]++] = static_cast<u16>(i);
+			}
+		}
+		m_num_codes = num_codes;
+
+		// Codes are stored msb first but read lsb first, so the table is indexed by reversed codes
+		m_fast.fill(0);
+		u32 code = 0;
+		u32 index = 0;
+		for (u32 length = 1; length <= c_FastBits; ++length) {
+			for (u32 i = 0; i < num_codes[length]; ++i, ++code, ++index) {
+				u32 reversed = 0;
+				for (u32 bit = 0; bit < length; ++bit) {
+					reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+				}
+				for (u32 fill = reversed; fill < (1u << c_FastBits); fill += 1u << length) {
+					m_fast[fill] = static_cast<u16>((m_symbols[index] << 4) | length);
+				}
+			}
+			code <<= 1;
+		}
+		return true;
+	}
+
+	/// Symbol and code length for the next bits, length 0 when the code is longer than the table
+	u16 LookupFast(u32 bits) const {
+		return m_fast[bits & ((1u << c_FastBits) - 1)];
+	}
+
+	/// Bit by bit decode, get_bit returns the next bit
+	template<typename GetBit>
+	i32 DecodeSlow(GetBit&& get_bit) const {
+		i32 code = 0;
+		i32 first = 0;
+		i32 index = 0;
+		for (u32 length = 1; length < 16; ++length) {
+			code |= get_bit();
+			const i32 count = m_num_codes[length];
+			if (code - count < first) {
+				return m_symbols[index + (code - first)];
+			}
+			index += count;
+			first = (first + count) << 1;
+			code <<= 1;
+		}
+		return -1;
+	}
+private:
+	std::array<u16, 16> m_num_codes{};
+	std::vector<u16> m_symbols;
+	std::array<u16, 1u << c_FastBits> m_fast{};
+};
+
+constexpr std::array<u16, 29> c_LengthBase = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr std::array<u8, 29> c_LengthExtra = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr std::array<u16, 30> c_DistanceBase = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+	193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr std::array<u8, 30> c_DistanceExtra = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+	6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+u8 PaethPredictor(i32 a, i32 b, i32 c) {
+	const i32 p = a + b - c;
+	const i32 pa = std::abs(p - a);
+	const i32 pb = std::abs(p - b);
+	const i32 pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) {
+		return static_cast<u8>(a);
+	}
+	return static_cast<u8>(pb <= pc ? b : c);
+}
+
+}
+
+/// Zlib stream decoder that produces its output in pieces of any size, only the 32 KiB
+/// window of earlier output is kept
+class Inflater {
+public:
+	Inflater(std::function<size_t(u8*, size_t)> read_input)
+		: m_read_input(std::move(read_input)), m_input(1 << 16), m_window(c_WindowSize) {}
+
+	/// Writes exactly count bytes to output, false on corrupt or truncated data
+	bool Read(u8* output, size_t count) {
+		if (!m_header_read) {
+			const u32 cmf = GetBits(8);
+			const u32 flags = GetBits(8);
+			// Deflate with at most a 32 KiB window and no preset dictionary
+			if ((cmf & 15) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flags) % 31 != 0 || (flags & 32)) {
+				return false;
+			}
+			m_header_read = true;
+		}
+
+		size_t written = 0;
+		while (written < count) {
+			if (m_error) {
+				return false;
+			}
+			if (m_copy_length > 0) {
+				const u32 n = static_cast<u32>(std::min<size_t>(m_copy_length, count - written));
+				for (u32 i = 0; i < n; ++i) {
+					output[written++] = Put(m_window[(m_window_pos - m_copy_distance) & (c_WindowSize - 1)]);
+				}
+				m_copy_length -= n;
+				continue;
+			}
+			if (!m_in_block) {
+				if (m_final_block || !StartBlock()) {
+					return false;
+				}
+				continue;
+			}
+			if (m_stored_remaining > 0) {
+				const u32 n = static_cast<u32>(std::min<size_t>(m_stored_remaining, count - written));
+				for (u32 i = 0; i < n; ++i) {
+					output[written++] = Put(static_cast<u8>(GetBits(8)));
+				}
+				m_stored_remaining -= n;
+				m_in_block = m_stored_remaining > 0;
+				continue;
+			}
+
+			const i32 symbol = Decode(m_literals);
+			if (symbol < 0) {
+				return false;
+			} else if (symbol < 256) {
+				output[written++] = Put(static_cast<u8>(symbol));
+			} else if (symbol == 256) {
+				m_in_block = false;
+			} else {
+				const u32 length_index = symbol - 257;
+				if (length_index >= c_LengthBase.size()) {
+					return false;
+				}
+				// The extra length bits come before the distance code
+				m_copy_length = c_LengthBase[length_index] + GetBits(c_LengthExtra[length_index]);
+				const i32 distance_symbol = Decode(m_distances);
+				if (distance_symbol < 0 || distance_symbol >= static_cast<i32>(c_DistanceBase.size())) {
+					return false;
+				}
+				m_copy_distance = c_DistanceBase[distance_symbol] + GetBits(c_DistanceExtra[distance_symbol]);
+				if (m_copy_distance > m_total_output) {
+					return false;
+				}
+			}
+		}
+		return !m_error;
+	}
+private:
+	static constexpr u32 c_WindowSize = 1u << 15;
+
+	u8 Put(u8 value) {
+		m_window[m_window_pos & (c_WindowSize - 1)] = value;
+		++m_window_pos;
+		++m_total_output;
+		return value;
+	}
+
+	void Refill() {
+		while (m_bit_count <= 56) {
+			if (m_input_pos == m_input_size) {
+				m_input_size = m_read_input(m_input.data(), m_input.size());
+				m_input_pos = 0;
+				if (m_input_size == 0) {
+					// Zeros past the end, only an error if they are used
+					m_padding_bits += 8;
+					m_bit_count += 8;
+					continue;
+				}
+			}
+			m_bits |= u64(m_input[m_input_pos++]) << m_bit_count;
+			m_bit_count += 8;
+		}
+	}
+
+	u32 GetBits(u32 count) {
+		if (count == 0) {
+			return 0;
+		}
+		if (m_bit_count < count) {
+			Refill();
+		}
+		const u32 value = static_cast<u32>(m_bits & ((u64(1) << count) - 1));
+		Consume(count);
+		return value;
+	}
+
+	void Consume(u32 count) {
+		m_bits >>= count;
+		m_bit_count -= count;
+		if (m_bit_count < m_padding_bits) {
+			m_error = true;
+		}
+	}
+
+	i32 Decode(const HuffmanTable& table) {
+		if (m_bit_count < 16) {
+			Refill();
+		}
+		const u16 entry = table.LookupFast(static_cast<u32>(m_bits));
+		if (entry != 0) {
+			Consume(entry & 15);
+			return entry >> 4;
+		}
+		return table.DecodeSlow([this]() { return static_cast<i32>(GetBits(1)); });
+	}
+
+	bool StartBlock() {
+		m_final_block = GetBits(1) != 0;
+		const u32 type = GetBits(2);
+		m_in_block = true;
+		if (type == 0) {
+			// Stored blocks start on a byte boundary
+			Consume(m_bit_count % 8);
+			const u32 length = GetBits(16);
+			const u32 inverse = GetBits(16);
+			if ((length ^ 0xffff) != inverse) {
+				return false;
+			}
+			m_stored_remaining = length;
+			m_in_block = length > 0;
+			return !m_error;
+		}
+		if (type == 1) {
+			std::array<u8, 288> lengths;
+			std::fill(lengths.begin(), lengths.begin() + 144, 8);
+			std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+			std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+			std::fill(lengths.begin() + 280, lengths.end(), 8);
+			std::array<u8, 30> distance_lengths;
+			distance_lengths.fill(5);
+			return m_literals.Build(lengths.data(), 288) && m_distances.Build(distance_lengths.data(), 30);
+		}
+		if (type == 2) {
+			return ReadDynamicTables();
+		}
+		return false;
+	}
+
+	bool ReadDynamicTables() {
+		const u32 num_literals = GetBits(5) + 257;
+		const u32 num_distances = GetBits(5) + 1;
+		const u32 num_code_lengths = GetBits(4) + 4;
+		if (num_literals > 286 || num_distances > 30) {
+			return false;
+		}
+
+		constexpr std::array<u8, 19> c_Order = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+		std::array<u8, 19> code_length_lengths{};
+		for (u32 i = 0; i < num_code_lengths; ++i) {
+			code_length_lengths[c_Order[i]] = static_cast<u8>(GetBits(3));
+		}
+		HuffmanTable code_lengths;
+		if (!code_lengths.Build(code_length_lengths.data(), 19)) {
+			return false;
+		}
+
+		std::array<u8, 286 + 30> lengths{};
+		for (u32 i = 0; i < num_literals + num_distances;) {
+			const i32 symbol = Decode(code_lengths);
+			if (symbol < 0) {
+				return false;
+			}
+			if (symbol < 16) {
+				lengths[i++] = static_cast<u8>(symbol);
+				continue;
+			}
+			u8 value = 0;
+			u32 repeat = 0;
+			if (symbol == 16) {
+				if (i == 0) {
+					return false;
+				}
+				value = lengths[i - 1];
+				repeat = 3 + GetBits(2);
+			} else if (symbol == 17) {
+				repeat = 3 + GetBits(3);
+			} else {
+				repeat = 11 + GetBits(7);
+			}
+			if (i + repeat > num_literals + num_distances) {
+				return false;
+			}
+			std::fill_n(lengths.begin() + i, repeat, value);
+			i += repeat;
+		}
+		if (lengths[256] == 0) {
+			return false;
+		}
+		return m_literals.Build(lengths.data(), num_literals)
+			&& m_distances.Build(lengths.data() + num_literals, num_distances) && !m_error;
+	}
+
+	std::function<size_t(u8*, size_t)> m_read_input;
+	std::vector<u8> m_input;
+	size_t m_input_pos = 0;
+	size_t m_input_size = 0;
+	u64 m_bits = 0;
+	u32 m_bit_count = 0;
+	u32 m_padding_bits = 0;
+	bool m_error = false;
+
+	bool m_header_read = false;
+	bool m_in_block = false;
+	bool m_final_block = false;
+	u32 m_stored_remaining = 0;
+	u32 m_copy_length = 0;
+	u32 m_copy_distance = 0;
+	HuffmanTable m_literals;
+	HuffmanTable m_distances;
+
+	std::vector<u8> m_window;
+	u32 m_window_pos = 0;
+	u64 m_total_output = 0;
+};
+
+ImageReader::ImageReader() = default;
+ImageReader::~ImageReader() = default;
+
+bool ImageReader::Open(const std::string& path) {
+	m_path = path;
+	m_file = std::ifstream(path, std::ios::binary);
+	m_next_row = 0;
+	if (!m_file) {
+		std::cerr << "ERROR: could not open " << path << "\n";
+		return false;
+	}
+
+	char magic[2] = {};
+	m_file.read(magic, 2);
+	m_file.seekg(0);
+	bool opened = false;
+	if (magic[0] == 'P' && magic[1] == '5') {
+		m_format = Format::Pgm;
+		opened = OpenPgm();
+	} else if (static_cast<u8>(magic[0]) == 0x89 && magic[1] == 'P') {
+		m_format = Format::Png;
+		opened = OpenPng();
+	} else {
+		std::cerr << "ERROR: " << path << " is not a binary pgm or a png\n";
+		return false;
+	}
+	if (opened && (m_size.x == 0 || m_size.y == 0 || m_size.x > c_MaxImageSize || m_size.y > c_MaxImageSize)) {
+		std::cerr << "ERROR: " << path << " is " << m_size.x << "x" << m_size.y << ", at most " << c_MaxImageSize << " pixels a side are supported\n";
+		return false;
+	}
+	return opened;
+}
+
+glm::uvec2 ImageReader::GetSize() const {
+	return m_size;
+}
+
+bool ImageReader::ReadRow(std::vector<u8>& row) {
+	if (m_next_row >= m_size.y) {
+		return false;
+	}
+	row.resize(m_size.x);
+
+	if (m_format == Format::Png) {
+		if (!ReadPngRow(row)) {
+			std::cerr << "ERROR: " << m_path << " is corrupt at row " << m_next_row << "\n";
+			return false;
+		}
+	} else {
+		m_raw_row.resize(m_size.x * m_bytes_per_sample);
+		if (!m_file.read(reinterpret_cast<char*>(m_raw_row.data()), m_raw_row.size())) {
+			std::cerr << "ERROR: " << m_path << " is truncated at row " << m_next_row << "\n";
+			return false;
+		}
+		for (u32 x = 0; x < m_size.x; ++x) {
+			row[x] = m_raw_row[x * m_bytes_per_sample];
+		}
+	}
+	++m_next_row;
+	return true;
+}
+
+bool ImageReader::OpenPgm() {
+	m_file.ignore(2);
+	// Width, height and max value, separated by whitespace and comments
+	u32 values[3] = {};
+	for (u32& value : values) {
+		int c = m_file.get();
+		while (c == '#' || std::isspace(c)) {
+			if (c == '#') {
+				while (c != '\n' && c != EOF) {
+					c = m_file.get();
+				}
+			}
+			c = m_file.get();
+		}
+		if (!std::isdigit(c)) {
+			std::cerr << "ERROR: " << m_path << " has an invalid pgm header\n";
+			return false;
+		}
+		u64 number = 0;
+		while (std::isdigit(c)) {
+			number = std::min<u64>(number * 10 + (c - '0'), ~0u);
+			c = m_file.get();
+		}
+		value = static_cast<u32>(number);
+	}
+	// A single whitespace character ends the header
+	m_size = glm::uvec2(values[0], values[1]);
+	if (values[2] == 0 || values[2] > 65535) {
+		std::cerr << "ERROR: " << m_path << " has an invalid pgm max value\n";
+		return false;
+	}
+	m_bytes_per_sample = values[2] > 255 ? 2 : 1;
+	return true;
+}
+
+bool ImageReader::OpenPng() {
+	u8 signature[8];
+	u8 header[8 + 13];
+	if (!m_file.read(reinterpret_cast<char*>(signature), 8) || !m_file.read(reinterpret_cast<char*>(header), sizeof(header))
+		|| ReadBigEndian(header) != 13 || std::string(reinterpret_cast<char*>(header + 4), 4) != "IHDR") {
+		std::cerr << "ERROR: " << m_path << " has an invalid png header\n";
+		return false;
+	}
+	m_file.ignore(4);
+
+	const u8* ihdr = header + 8;
+	m_size = glm::uvec2(ReadBigEndian(ihdr), ReadBigEndian(ihdr + 4));
+	m_bit_depth = ihdr[8];
+	const u32 color_type = ihdr[9];
+	const u32 interlace = ihdr[12];
+	switch (color_type) {
+	case 0: m_channels = 1; break;
+	case 2: m_channels = 3; break;
+	case 3: m_channels = 1; break;
+	case 4: m_channels = 2; break;
+	case 6: m_channels = 4; break;
+	default:
+		std::cerr << "ERROR: " << m_path << " has unknown png color type " << color_type << "\n";
+		return false;
+	}
+	const bool valid_depth = (color_type == 0 && (m_bit_depth == 1 || m_bit_depth == 2 || m_bit_depth == 4 || m_bit_depth == 8 || m_bit_depth == 16))
+		|| (color_type == 3 && (m_bit_depth == 1 || m_bit_depth == 2 || m_bit_depth == 4 || m_bit_depth == 8))
+		|| ((color_type == 2 || color_type == 4 || color_type == 6) && (m_bit_depth == 8 || m_bit_depth == 16));
+	if (!valid_depth || ihdr[10] != 0 || ihdr[11] != 0) {
+		std::cerr << "ERROR: " << m_path << " has an invalid png bit depth or compression\n";
+		return false;
+	}
+	if (interlace != 0) {
+		std::cerr << "ERROR: " << m_path << " is interlaced, which can not be streamed by row\n";
+		return false;
+	}
+	if (u64(m_size.x) * m_channels * m_bit_depth > u64(~0u) - 7) {
+		std::cerr << "ERROR: " << m_path << " is too wide\n";
+		return false;
+	}
+
+	m_stride = static_cast<u32>((u64(m_size.x) * m_channels * m_bit_depth + 7) / 8);
+	m_bytes_per_pixel = std::max(1u, m_channels * m_bit_depth / 8);
+	m_chunk_remaining = 0;
+	m_data_done = false;
+	m_row.assign(m_stride + 1, 0);
+	m_previous_row.assign(m_stride, 0);
+	m_inflater = std::make_unique<Inflater>([this](u8* buffer, size_t capacity) {
+		return ReadPngData(buffer, capacity);
+	});
+	return true;
+}
+
+size_t ImageReader::ReadPngData(u8* buffer, size_t capacity) {
+	while (m_chunk_remaining == 0) {
+		if (m_data_done) {
+			return 0;
+		}
+		// Skips chunks until the next IDAT, the crc of the previous one is skipped with it
+		u8 chunk_header[8];
+		if (!m_file.read(reinterpret_cast<char*>(chunk_header), 8)) {
+			m_data_done = true;
+			return 0;
+		}
+		const u32 length = ReadBigEndian(chunk_header);
+		const std::string type(reinterpret_cast<char*>(chunk_header + 4), 4);
+		if (type == "IDAT") {
+			m_chunk_remaining = length;
+			if (length == 0) {
+				m_file.ignore(4);
+			}
+		} else if (type == "IEND") {
+			m_data_done = true;
+			return 0;
+		} else {
+			m_file.ignore(u64(length) + 4);
+		}
+	}
+
+	const size_t count = std::min<size_t>(capacity, m_chunk_remaining);
+	if (!m_file.read(reinterpret_cast<char*>(buffer), count)) {
+		m_data_done = true;
+		return static_cast<size_t>(m_file.gcount());
+	}
+	m_chunk_remaining -= static_cast<u32>(count);
+	if (m_chunk_remaining == 0) {
+		m_file.ignore(4);
+	}
+	return count;
+}
+
+bool ImageReader::ReadPngRow(std::vector<u8>& row) {
+	if (!m_inflater->Read(m_row.data(), m_row.size())) {
+		return false;
+	}
+
+	const u8 filter = m_row[0];
+	u8* current = m_row.data() + 1;
+	const u8* previous = m_previous_row.data();
+	const u32 bpp = m_bytes_per_pixel;
+	switch (filter) {
+	case 0:
+		break;
+	case 1:
+		for (u32 i = bpp; i < m_stride; ++i) {
+			current[i] += current[i - bpp];
+		}
+		break;
+	case 2:
+		for (u32 i = 0; i < m_stride; ++i) {
+			current[i] += previous[i];
+		}
+		break;
+	case 3:
+		for (u32 i = 0; i < m_stride; ++i) {
+			const u32 left = i >= bpp ? current[i - bpp] : 0;
+			current[i] += static_cast<u8>((left + previous[i]) / 2);
+		}
+		break;
+	case 4:
+		for (u32 i = 0; i < m_stride; ++i) {
+			const i32 left = i >= bpp ? current[i - bpp] : 0;
+			const i32 up_left = i >= bpp ? previous[i - bpp] : 0;
+			current[i] += PaethPredictor(left, previous[i], up_left);
+		}
+		break;
+	default:
+		return false;
+	}
+	std::copy(current, current + m_stride, m_previous_row.begin());
+
+	if (m_bit_depth < 8) {
+		const u32 pixels_per_byte = 8 / m_bit_depth;
+		const u32 mask = (1u << m_bit_depth) - 1;
+		for (u32 x = 0; x < m_size.x; ++x) {
+			const u32 shift = 8 - m_bit_depth * (x % pixels_per_byte + 1);
+			row[x] = static_cast<u8>((current[x / pixels_per_byte] >> shift) & mask);
+		}
+	} else {
+		// First channel of each pixel, the high byte of 16 bit samples comes first
+		for (u32 x = 0; x < m_size.x; ++x) {
+			row[x] = current[x * bpp];
+		}
+	}
+	return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include "util/IntTypes.hpp"
+
+class Inflater;
+
+/// Reads an image one row at a time, so only a couple of rows are decoded in memory.
+/// Supports binary PGM (P5) and non interlaced PNG of every color type and bit depth.
+/// Each pixel becomes one material value: the gray level, the palette index or the red channel,
+/// 16 bit samples keep their high byte. Rows come top to bottom as stored in the file.
+class ImageReader {
+public:
+	ImageReader();
+	~ImageReader();
+	ImageReader(const ImageReader&) = delete;
+	ImageReader& operator=(const ImageReader&) = delete;
+
+	/// Reads the header, prints an error and returns false if the file can not be read
+	bool Open(const std::string& path);
+
+	glm::uvec2 GetSize() const;
+
+	/// Decodes the next row into row, resized to the image width. Returns false past the
+	/// last row or when the file is truncated or corrupt.
+	bool ReadRow(std::vector<u8>& row);
+private:
+	enum class Format {
+		Pgm,
+		Png,
+	};
+
+	bool OpenPgm();
+	bool OpenPng();
+	bool ReadPngRow(std::vector<u8>& row);
+	/// Fills buffer with the next bytes of the IDAT chunks, returns how many were read
+	size_t ReadPngData(u8* buffer, size_t capacity);
+
+	std::string m_path;
+	std::ifstream m_file;
+	Format m_format = Format::Pgm;
+	glm::uvec2 m_size{};
+	u32 m_next_row = 0;
+
+	// Pgm
+	u32 m_bytes_per_sample = 1;
+	std::vector<u8> m_raw_row;
+
+	// Png
+	u32 m_bit_depth = 8;
+	u32 m_channels = 1;
+	u32 m_stride = 0;
+	u32 m_bytes_per_pixel = 1;
+	u32 m_chunk_remaining = 0;
+	bool m_data_done = false;
+	std::unique_ptr<Inflater> m_inflater;
+	std::vector<u8> m_row;
+	std::vector<u8> m_previous_row;
+};
@@ -0,0 +1,151 @@
+#include "SdfSmoothing.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+#include "util/IntTypes.hpp"
+#include "util/ParallelFor.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SDF_SMOOTHING_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SDF_SMOOTHING_SSE2
+#endif
+
+namespace {
+
+#if defined(SDF_SMOOTHING_AVX2)
+struct Lanes {
+	static constexpr u32 c_Count = 8;
+	__m256 value;
+
+	static Lanes Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+	static Lanes Set(float v) { return { _mm256_set1_ps(v) }; }
+	void Store(float* p) const { _mm256_storeu_ps(p, value); }
+	Lanes operator+(Lanes o) const { return { _mm256_add_ps(value, o.value) }; }
+	Lanes operator*(Lanes o) const { return { _mm256_mul_ps(value, o.value) }; }
+	static Lanes Min(Lanes a, Lanes b) { return { _mm256_min_ps(a.value, b.value) }; }
+	static Lanes Max(Lanes a, Lanes b) { return { _mm256_max_ps(a.value, b.value) }; }
+	void Extract(float* out) const { _mm256_storeu_ps(out, value); }
+};
+#elif defined(SDF_SMOOTHING_SSE2)
+struct Lanes {
+	static constexpr u32 c_Count = 4;
+	__m128 value;
+
+	static Lanes Load(const float* p) { return { _mm_loadu_ps(p) }; }
+	static Lanes Set(float v) { return { _mm_set1_ps(v) }; }
+	void Store(float* p) const { _mm_storeu_ps(p, value); }
+	Lanes operator+(Lanes o) const { return { _mm_add_ps(value, o.value) }; }
+	Lanes operator*(Lanes o) const { return { _mm_mul_ps(value, o.value) }; }
+	static Lanes Min(Lanes a, Lanes b) { return { _mm_min_ps(a.value, b.value) }; }
+	static Lanes Max(Lanes a, Lanes b) { return { _mm_max_ps(a.value, b.value) }; }
+	void Extract(float* out) const { _mm_storeu_ps(out, value); }
+};
+#else
+struct Lanes {
+	static constexpr u32 c_Count = 1;
+	float value;
+
+	static Lanes Load(const float* p) { return { *p }; }
+	static Lanes Set(float v) { return { v }; }
+	void Store(float* p) const { *p = value; }
+	Lanes operator+(Lanes o) const { return { value + o.value }; }
+	Lanes operator*(Lanes o) const { return { value * o.value }; }
+	static Lanes Min(Lanes a, Lanes b) { return { std::min(a.value, b.value) }; }
+	static Lanes Max(Lanes a, Lanes b) { return { std::max(a.value, b.value) }; }
+	void Extract(float* out) const { *out = value; }
+};
+#endif
+
+/// out[x] = in[x-1] + 2 in[x] + in[x+1], with the borders clamped outside the inner loop
+void FilterRow(const float* in, u32 width, float* out) {
+	if (width == 1) {
+		out[0] = 4.f * in[0];
+		return;
+	}
+	out[0] = 3.f * in[0] + in[1];
+	out[width - 1] = in[width - 2] + 3.f * in[width - 1];
+
+	const Lanes two = Lanes::Set(2.f);
+	u32 x = 1;
+	for (; x + Lanes::c_Count < width; x += Lanes::c_Count) {
+		Lanes left = Lanes::Load(in + x - 1);
+		Lanes center = Lanes::Load(in + x);
+		Lanes right = Lanes::Load(in + x + 1);
+		(left + center * two + right).Store(out + x);
+	}
+	for (; x + 1 < width; ++x) {
+		out[x] = in[x - 1] + 2.f * in[x] + in[x + 1];
+	}
+}
+
+}
+
+void SmoothDistances(const std::vector<float>& distances, glm::uvec2 size, std::vector<float>& smoothed, float& min_distance, float& max_distance) {
+	const u32 width = size.x;
+	const u32 height = size.y;
+	smoothed.resize(static_cast<size_t>(width) * height);
+
+	min_distance = std::numeric_limits<float>::max();
+	max_distance = std::numeric_limits<float>::lowest();
+	std::mutex min_max_mutex;
+
+	ParallelFor(height, 32, [&](u32 begin, u32 end) {
+		// Horizontally filtered rows y-1, y and y+1, clamped at the top and bottom
+		std::vector<float> row_buffers(3 * width);
+		float* above = &row_buffers[0];
+		float* center = &row_buffers[width];
+		float* below = &row_buffers[2 * width];
+
+		auto row = [&](u32 y) { return &distances[static_cast<size_t>(y) * width]; };
+		FilterRow(row(begin == 0 ? 0 : begin - 1), width, above);
+		FilterRow(row(begin), width, center);
+
+		const Lanes two = Lanes::Set(2.f);
+		const Lanes scale = Lanes::Set(c_SdfSmoothingScale);
+		Lanes lanes_min = Lanes::Set(std::numeric_limits<float>::max());
+		Lanes lanes_max = Lanes::Set(std::numeric_limits<float>::lowest());
+		float band_min = std::numeric_limits<float>::max();
+		float band_max = std::numeric_limits<float>::lowest();
+
+		for (u32 y = begin; y < end; ++y) {
+			FilterRow(row(y + 1 < height ? y + 1 : y), width, below);
+
+			float* out = &smoothed[static_cast<size_t>(y) * width];
+			u32 x = 0;
+			for (; x + Lanes::c_Count <= width; x += Lanes::c_Count) {
+				Lanes sum = (Lanes::Load(above + x) + Lanes::Load(center + x) * two + Lanes::Load(below + x)) * scale;
+				sum.Store(out + x);
+				lanes_min = Lanes::Min(lanes_min, sum);
+				lanes_max = Lanes::Max(lanes_max, sum);
+			}
+			for (; x < width; ++x) {
+				float sum = (above[x] + 2.f * center[x] + below[x]) * c_SdfSmoothingScale;
+				out[x] = sum;
+				band_min = std::min(band_min, sum);
+				band_max = std::max(band_max, sum);
+			}
+
+			std::swap(above, center);
+			std::swap(center, below);
+		}
+
+		float lane_values[Lanes::c_Count];
+		lanes_min.Extract(lane_values);
+		for (float value : lane_values) {
+			band_min = std::min(band_min, value);
+		}
+		lanes_max.Extract(lane_values);
+		for (float value : lane_values) {
+			band_max = std::max(band_max, value);
+		}
+
+		std::lock_guard lock(min_max_mutex);
+		min_distance = std::min(min_distance, band_min);
+		max_distance = std::max(max_distance, band_max);
+	});
+}
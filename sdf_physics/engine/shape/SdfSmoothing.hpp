@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+#include <glm/vec2.hpp>
+
+/// Scale of the smoothing kernel, the 1-2-1 x 1-2-1 kernel is normalized by 1/16 and the
+/// result has always been scaled by another 1/9, which the physics tuning depends on
+constexpr float c_SdfSmoothingScale = 1.f / (16.f * 9.f);
+
+/// Stored distances are distances in pixels times this
+constexpr float c_SdfDistanceScale = 16.f * c_SdfSmoothingScale;
+
+/// Separable 1-2-1 filter with clamped borders, also returns the min and max of the output.
+/// Rows are split across the worker threads and the inner loops use SSE2 or AVX2 when available.
+void SmoothDistances(const std::vector<float>& distances, glm::uvec2 size, std::vector<float>& smoothed, float& min_distance, float& max_distance);
@@ -1,21 +1,82 @@
 #include "Shape.hpp"
 
-#include <glm/gtc/noise.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <glm/glm.hpp>
 #include <glm/gtx/component_wise.hpp>
-#include <time.h>
+// Defines the noise functions, so only this file can include it
+#include <FastNoiseLite/FastNoiseLite.h>
 #include "ShapeMetadata.hpp"
 #include <glm/gtx/norm.hpp>
+#include "DistanceTransform.hpp"
+#include "SdfSmoothing.hpp"
+#include "util/ParallelFor.hpp"
+#include "util/Profiler.hpp"
 
-Shape::Shape() {
-	m_size = glm::uvec2(128);
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The bits of a word whose index has bit k set
+constexpr u64 c_BitIndexMasks[6] = {
+	0xaaaaaaaaaaaaaaaaull,
+	0xccccccccccccccccull,
+	0xf0f0f0f0f0f0f0f0ull,
+	0xff00ff00ff00ff00ull,
+	0xffff0000ffff0000ull,
+	0xffffffff00000000ull,
+};
 
-	GenerateRandomShape();
 }
 
-Shape::Shape(glm::uvec2 size) {
+Shape::Shape()
+	: Shape(glm::uvec2(128)) {
+}
+
+Shape::Shape(glm::uvec2 size, SdfSettings sdf_settings)
+	: Shape(size, static_cast<u32>(rand()), sdf_settings) {
+}
+
+Shape::Shape(glm::uvec2 size, u32 seed, SdfSettings sdf_settings) {
 	m_size = size;
+	m_image = GenerateRandomImage(size, seed);
+	CreateOccupancy();
+	CreateConvexHull();
+	CreateSolidBounds();
 
-	GenerateRandomShape();
+	m_sdf.Create(m_image, m_size, sdf_settings);
+}
+
+Shape::Shape(glm::uvec2 size, std::vector<u8> image, SdfSettings sdf_settings) {
+	m_size = size;
+	m_image = std::move(image);
+	CreateOccupancy();
+	CreateConvexHull();
+	CreateSolidBounds();
+
+	m_sdf.Create(m_image, m_size, sdf_settings);
+}
+
+Shape::Shape(Empty) {
+	m_size = glm::uvec2(0);
+}
+
+PixelRect Shape::EditImage(PixelRect rect, const std::vector<u8>& pixels) {
+	auto size = rect.GetSize();
+	m_solid_moments -= CountSolidMoments(rect);
+	for (u32 y = 0; y < size.y; ++y) {
+		std::memcpy(&m_image[rect.min.x + (rect.min.y + y) * m_size.x], &pixels[y * size.x], size.x);
+	}
+	UpdateOccupancy(rect);
+	m_solid_moments += CountSolidMoments(rect);
+	CreateConvexHull();
+	CreateSolidBounds();
+	return m_sdf.Update(m_image, rect);
 }
 
 const glm::uvec2& Shape::GetSize() const {
@@ -30,6 +91,245 @@ u8 Shape::GetPixelAt(glm::uvec2 pixel) const {
 	return m_image[pixel.x + pixel.y * m_size.x];
 }
 
+bool Shape::IsSolid(glm::uvec2 pixel) const {
+	return (m_occupancy[(pixel.x >> 6) + pixel.y * m_occupancy_stride] >> (pixel.x & 63)) & 1;
+}
+
+const std::vector<u64>& Shape::GetOccupancy() const {
+	return m_occupancy;
+}
+
+u32 Shape::GetOccupancyStride() const {
+	return m_occupancy_stride;
+}
+
+u32 Shape::GetNumSolidPixels() const {
+	return static_cast<u32>(m_solid_moments.count);
+}
+
+const PixelMoments& Shape::GetSolidMoments() const {
+	return m_solid_moments;
+}
+
+glm::vec2 Shape::GetSolidCenter() const {
+	if (m_solid_moments.count == 0) {
+		return glm::vec2(0.f);
+	}
+	const double count = double(m_solid_moments.count);
+	const glm::dvec2 mean(m_solid_moments.sum_x / count, m_solid_moments.sum_y / count);
+	return c_PixelSizeMeters * (glm::vec2(mean) + 0.5f);
+}
+
+float Shape::GetSolidSecondMoment() const {
+	if (m_solid_moments.count == 0) {
+		return 0.f;
+	}
+	// Parallel axis theorem from the pixel centers to the center, plus 1/6 for each unit square around its own center
+	const double count = double(m_solid_moments.count);
+	const glm::dvec2 mean(m_solid_moments.sum_x / count, m_solid_moments.sum_y / count);
+	const double sum_squares = double(m_solid_moments.sum_xx) + double(m_solid_moments.sum_yy);
+	const double pixels = sum_squares - count * glm::dot(mean, mean) + count / 6.0;
+	return static_cast<float>(pixels * c_PixelAreaMeters * c_PixelAreaMeters);
+}
+
+const std::vector<glm::vec2>& Shape::GetConvexHull() const {
+	return m_convex_hull;
+}
+
+const SolidBounds& Shape::GetSolidBounds() const {
+	return m_solid_bounds;
+}
+
+PixelMoments& PixelMoments::operator+=(const PixelMoments& other) {
+	count += other.count;
+	sum_x += other.sum_x;
+	sum_y += other.sum_y;
+	sum_xx += other.sum_xx;
+	sum_yy += other.sum_yy;
+	return *this;
+}
+
+PixelMoments& PixelMoments::operator-=(const PixelMoments& other) {
+	count -= other.count;
+	sum_x -= other.sum_x;
+	sum_y -= other.sum_y;
+	sum_xx -= other.sum_xx;
+	sum_yy -= other.sum_yy;
+	return *this;
+}
+
+void Shape::CreateOccupancy() {
+	m_occupancy_stride = (m_size.x + 63) / 64;
+	m_occupancy.assign(size_t(m_occupancy_stride) * m_size.y, 0);
+	const PixelRect whole_image{ glm::uvec2(0), m_size };
+	UpdateOccupancy(whole_image);
+	m_solid_moments = CountSolidMoments(whole_image);
+}
+
+void Shape::UpdateOccupancy(PixelRect rect) {
+	const u32 first_word = rect.min.x >> 6;
+	const u32 end_word = (rect.max.x + 63) >> 6;
+	for (u32 y = rect.min.y; y < rect.max.y; ++y) {
+		const u8* row = &m_image[size_t(y) * m_size.x];
+		u64* words = &m_occupancy[size_t(y) * m_occupancy_stride];
+		for (u32 word = first_word; word < end_word; ++word) {
+			const u32 begin_x = word * 64;
+			const u32 end_x = glm::min(begin_x + 64, m_size.x);
+			u64 bits = 0;
+			u32 x = begin_x;
+			// Eight pixels at a time: fold each byte down to its lowest bit, then gather the
+			// eight lowest bits into the top byte with one multiply
+			for (; x + 8 <= end_x; x += 8) {
+				u64 bytes;
+				std::memcpy(&bytes, row + x, 8);
+				bytes |= bytes >> 4;
+				bytes |= bytes >> 2;
+				bytes |= bytes >> 1;
+				bytes &= 0x0101010101010101ull;
+				bits |= ((bytes * 0x0102040810204080ull) >> 56) << (x - begin_x);
+			}
+			for (; x < end_x; ++x) {
+				bits |= u64(row[x] != c_MaterialEmptySpace) << (x - begin_x);
+			}
+			words[word] = bits;
+		}
+	}
+}
+
+PixelMoments Shape::CountSolidMoments(PixelRect rect) const {
+	PixelMoments moments;
+	if (rect.min.x >= rect.max.x) {
+		return moments;
+	}
+	const u32 first_word = rect.min.x >> 6;
+	const u32 last_word = (rect.max.x - 1) >> 6;
+	const u64 first_mask = ~0ull << (rect.min.x & 63);
+	const u64 last_mask = ~0ull >> (63 - ((rect.max.x - 1) & 63));
+	for (u32 y = rect.min.y; y < rect.max.y; ++y) {
+		const u64* words = &m_occupancy[size_t(y) * m_occupancy_stride];
+		u64 row_count = 0;
+		for (u32 word = first_word; word <= last_word; ++word) {
+			u64 bits = words[word];
+			if (word == first_word) {
+				bits &= first_mask;
+			}
+			if (word == last_word) {
+				bits &= last_mask;
+			}
+			if (bits == 0) {
+				continue;
+			}
+			// Sums of the bit indices i and i*i from popcounts of the bits of i, with
+			// i*i = sum over bits j and k of i of 2^(j+k). Words inside a shape are full.
+			const u64 count = std::popcount(bits);
+			u64 sum = 2016;
+			u64 sum_squares = 85344;
+			if (count < 64) {
+				sum = 0;
+				sum_squares = 0;
+				for (u32 j = 0; j < 6; ++j) {
+					const u64 bits_j = bits & c_BitIndexMasks[j];
+					sum += u64(std::popcount(bits_j)) << j;
+					sum_squares += u64(std::popcount(bits_j)) << (2 * j);
+					for (u32 k = j + 1; k < 6; ++k) {
+						sum_squares += u64(std::popcount(bits_j & c_BitIndexMasks[k])) << (j + k + 1);
+					}
+				}
+			}
+			const u64 base = u64(word) * 64;
+			row_count += count;
+			moments.sum_x += count * base + sum;
+			moments.sum_xx += count * base * base + 2 * base * sum + sum_squares;
+		}
+		moments.count += row_count;
+		moments.sum_y += row_count * y;
+		moments.sum_yy += row_count * y * y;
+	}
+	return moments;
+}
+
+void Shape::CreateConvexHull() {
+	// Only the ends of each row can be on the hull, they come sorted by y then x
+	std::vector<glm::ivec2> points;
+	for (u32 y = 0; y < m_size.y; ++y) {
+		const u64* words = &m_occupancy[size_t(y) * m_occupancy_stride];
+		u32 first = 0;
+		while (first < m_occupancy_stride && words[first] == 0) {
+			++first;
+		}
+		if (first == m_occupancy_stride) {
+			continue;
+		}
+		u32 last = m_occupancy_stride - 1;
+		while (words[last] == 0) {
+			--last;
+		}
+		const i32 min_x = first * 64 + std::countr_zero(words[first]);
+		const i32 max_x = last * 64 + 63 - std::countl_zero(words[last]);
+		points.emplace_back(min_x, y);
+		if (max_x != min_x) {
+			points.emplace_back(max_x, y);
+		}
+	}
+
+	// Monotone chain, in integers so collinear points are dropped exactly. Sorting by y
+	// instead of x mirrors the winding, so the chains are built clockwise and reversed.
+	auto cross = [](glm::ivec2 o, glm::ivec2 a, glm::ivec2 b) {
+		return i64(a.x - o.x) * (b.y - o.y) - i64(a.y - o.y) * (b.x - o.x);
+	};
+	std::vector<glm::ivec2> hull;
+	if (points.size() <= 2) {
+		hull = points;
+	} else {
+		hull.resize(2 * points.size());
+		size_t count = 0;
+		for (size_t i = 0; i < points.size(); ++i) {
+			while (count >= 2 && cross(hull[count - 2], hull[count - 1], points[i]) >= 0) {
+				--count;
+			}
+			hull[count++] = points[i];
+		}
+		const size_t lower_count = count + 1;
+		for (size_t i = points.size() - 1; i > 0; --i) {
+			while (count >= lower_count && cross(hull[count - 2], hull[count - 1], points[i - 1]) >= 0) {
+				--count;
+			}
+			hull[count++] = points[i - 1];
+		}
+		// The first point was added again to close the chain
+		hull.resize(count - 1);
+		std::reverse(hull.begin(), hull.end());
+	}
+
+	m_convex_hull.clear();
+	for (auto& point : hull) {
+		m_convex_hull.push_back(c_PixelSizeMeters * (glm::vec2(point) + 0.5f));
+	}
+}
+
+void Shape::CreateSolidBounds() {
+	m_solid_bounds = SolidBounds{};
+	if (m_convex_hull.empty()) {
+		return;
+	}
+
+	const glm::vec2 center = GetSolidCenter();
+	glm::vec2 min(std::numeric_limits<float>::max());
+	glm::vec2 max(std::numeric_limits<float>::lowest());
+	float radius_squared = 0.f;
+	for (auto& vertex : m_convex_hull) {
+		const glm::vec2 offset = vertex - center;
+		min = glm::min(min, offset);
+		max = glm::max(max, offset);
+		radius_squared = glm::max(radius_squared, glm::dot(offset, offset));
+	}
+	// The hull goes through pixel centers, the pixels reach half a pixel further
+	const float half_pixel = 0.5f * c_PixelSizeMeters;
+	m_solid_bounds.radius = glm::sqrt(radius_squared) + glm::root_two<float>() * half_pixel;
+	m_solid_bounds.box_min = min - half_pixel;
+	m_solid_bounds.box_max = max + half_pixel;
+}
+
 glm::vec2 Shape::GetSizeInMeters() const {
 	return c_PixelSizeMeters * glm::vec2(m_size);
 }
@@ -54,133 +354,231 @@ void Shape::SetId(ShapeId id) {
 	m_id = id;
 }
 
-void Shape::GenerateRandomShape() {
-	m_image.resize(glm::compMul(m_size));
+std::vector<u8> Shape::GenerateRandomImage(glm::uvec2 size, u32 seed) {
+	PROFILE_ZONE("Shape::GenerateRandomImage");
 
-	auto rand_x = 0.03f * (rand() % 2000);
-	auto rand_y = 0.03f * (rand() % 2000);
+	std::vector<u8> image(glm::compMul(size), c_MaterialEmptySpace);
 
-	glm::vec2 center = glm::vec2(m_size) * 0.5f;
-	float radius = center.x;
-	for (u32 y = 0; y < m_size.y; ++y) {
-		for (u32 x = 0; x < m_size.x; ++x) {
-			auto pos = glm::vec2(x, y);
-			float noise = 0.5f + 0.5f * glm::simplex(0.02f * pos + glm::vec2(rand_x, rand_y));
-			//noise = 1.0f;
+	fnl_state noise = fnlCreateState();
+	noise.seed = static_cast<int>(seed);
+	noise.noise_type = FNL_NOISE_OPENSIMPLEX2;
+	noise.frequency = 0.02f;
+
+	// Noise in [0, 1] times the falloff is only above 0.5 where the falloff is,
+	// inside 0.75 radius, so the noise is not evaluated further out
+	const float radius = 0.5f * size.x;
+	const float solid_radius = 0.75f * radius;
+	ParallelFor(size.y, 16, [&](u32 begin, u32 end) {
+		fnl_state row_noise = noise;
+		for (u32 y = begin; y < end; ++y) {
+			const float dy = radius - y;
+			const float half_width_squared = solid_radius * solid_radius - dy * dy;
+			if (half_width_squared <= 0.f) {
+				continue;
+			}
+			const float half_width = glm::sqrt(half_width_squared);
+			const u32 x_begin = static_cast<u32>(glm::max(glm::ceil(radius - half_width), 0.f));
+			const u32 x_end = static_cast<u32>(glm::clamp(glm::floor(radius + half_width) + 1.f, 0.f, float(size.x)));
+			for (u32 x = x_begin; x < x_end; ++x) {
+				const glm::vec2 pos(x, y);
+				float value = 0.5f + 0.5f * fnlGetNoise2D(&row_noise, pos.x, pos.y);
+				value *= glm::smoothstep(radius, radius * 0.5f, glm::length(radius - pos));
+				if (value > 0.5f) {
+					image[x + y * size.x] = 1;
+				}
+			}
+		}
+	});
+	return image;
+}
 
-			noise *= glm::smoothstep(radius, radius*0.5f, glm::length(radius - pos));
+void ShapeSdf::Create(const std::vector<u8>& image, glm::uvec2 size, SdfSettings settings) {
+	PROFILE_ZONE("ShapeSdf::Create");
 
-			auto& pixel = m_image[x + y * m_size.x];
-			if (noise > 0.5f) {
-				pixel = 1;
-			} else {
-				pixel = c_MaterialEmptySpace;
+	m_storage = settings.storage;
+	m_format = m_storage == SdfStorage::Dense ? settings.format : SdfFormat::Float32;
+	m_layout = m_storage == SdfStorage::Dense ? settings.layout : SdfLayout::RowMajor;
+	m_size = size;
+
+	std::vector<i32> outside_squared;
+	std::vector<i32> inside_squared;
+	ComputeSquaredDistances(image, size, true, outside_squared);
+	ComputeSquaredDistances(image, size, false, inside_squared);
+
+	std::vector<float> distances(size.x * size.y);
+
+	ParallelFor(size.y, 16, [&](u32 begin, u32 end) {
+		for (u32 i = begin * size.x; i < end * size.x; ++i) {
+			float outside_distance = glm::sqrt(static_cast<float>(outside_squared[i]));
+			float inside_distance = glm::sqrt(static_cast<float>(inside_squared[i]));
+
+			if (outside_distance > 0.f) {
+				outside_distance -= 0.5f;
+			}
+			if (inside_distance > 0.f) {
+				inside_distance -= 0.5f;
 			}
+			distances[i] = outside_distance - inside_distance;
 		}
+	});
+
+	SmoothDistances(distances, size, m_distances, m_min_distance, m_max_distance);
+
+	if (m_storage == SdfStorage::Tiled) {
+		CreateTiles();
+	} else {
+		CreateDense();
 	}
 
-	m_sdf.Create(m_image, m_size);
+	CreateLevels();
+
+	m_gradients.clear();
+	if (settings.gradients && m_storage == SdfStorage::Dense) {
+		m_gradients.resize(2 * size.x * size.y);
+		UpdateGradients({ glm::uvec2(0), size });
+	}
 }
 
-void ShapeSdf::Create(const std::vector<u8>& image, glm::uvec2 size) {
-	m_size = size;
+PixelRect ShapeSdf::Update(const std::vector<u8>& image, PixelRect edited_pixels) {
+	PROFILE_ZONE("ShapeSdf::Update");
 
-	// From http://www.codersnotes.com/notes/signed-distance-fields/
+	const glm::ivec2 size = m_size;
+	auto expand = [&size](PixelRect rect, i32 amount) {
+		rect.min = glm::uvec2(glm::max(glm::ivec2(rect.min) - amount, glm::ivec2(0)));
+		rect.max = glm::uvec2(glm::min(glm::ivec2(rect.max) + amount, size));
+		return rect;
+	};
 
-	struct Point {
-		glm::ivec2 delta{ 9999, 9999 };
-		int SquaredDistance() const {
-			return delta.x * delta.x + delta.y * delta.y;
+	// A distance only changes if an edited pixel is at most as far away as its old closest
+	// seed. The stored distances are smoothed and scaled, the slack covers the smoothing.
+	const glm::ivec2 edited_min = edited_pixels.min;
+	const glm::ivec2 edited_max = glm::ivec2(edited_pixels.max) - 1;
+	// Constant tiles only know the distance closest to the surface, it grows at most by the tile diagonal
+	auto is_affected = [&](i32 x, i32 y) {
+		float old_distance = glm::abs(GetDistance({ x, y })) / c_SdfDistanceScale + 3.f;
+		if (m_storage == SdfStorage::Tiled && GetTile({ x, y }).offset == Tile::c_Constant) {
+			old_distance += 1.5f * c_SdfTileSize;
 		}
+		glm::ivec2 delta = glm::max(glm::max(edited_min - glm::ivec2(x, y), glm::ivec2(x, y) - edited_max), glm::ivec2(0));
+		return static_cast<float>(delta.x * delta.x + delta.y * delta.y) <= old_distance * old_distance;
 	};
-	class Grid {
-	public:
-		Grid(glm::uvec2 size) {
-			this->size = size;
-			points.resize(size.x * size.y);
-		}
-		Point Get(glm::ivec2 index) {
-			if (index.x >= 0 && index.y >= 0 && index.x < size.x && index.y < size.y) {
-				return points[index.x + index.y * size.x];
-			} else {
-				return {};
-			}
-		}
-		void Set(glm::ivec2 index, Point point) {
-			points[index.x + index.y * size.x] = point;
-		}
-		void GenerateSdf() {
-			for (i32 y = 0; y < size.y; ++y) {
-				for (i32 x = 0; x < size.x; ++x) {
-					Point point = Get({x, y});
-					Compare(point, {x,y}, {-1, 0});
-					Compare(point, {x,y}, {0, -1});
-					Compare(point, {x,y}, {-1, -1});
-					Compare(point, {x,y}, {1, -1});
-					Set({x, y}, point);
-				}
-				for (i32 x = size.x-1; x >= 0; --x) {
-					Point point = Get({x, y});
-					Compare(point, {x,y}, {1, 0});
-					Set({x, y}, point);
-				}
-			}
 
-			for (i32 y = size.y-1; y >= 0; --y) {
-				for (i32 x = size.x-1; x >= 0; --x) {
-					Point point = Get({x, y});
-					Compare(point, {x,y}, {1, 0});
-					Compare(point, {x,y}, {0, 1});
-					Compare(point, {x,y}, {-1, 1});
-					Compare(point, {x,y}, {1, 1});
-					Set({x, y}, point);
-				}
-				for (i32 x = 0; x < size.x; ++x) {
-					Point point = Get({x, y});
-					Compare(point, {x,y}, {-1, 0});
-					Set({x, y}, point);
-				}
+	// Grow the edited rect one side at a time while the ring outside it has affected pixels,
+	// the affected pixels are connected to the edit by straight lines
+	PixelRect affected = edited_pixels;
+	auto column_affected = [&](i32 x) {
+		for (i32 y = glm::max(i32(affected.min.y) - 1, 0); y < glm::min(i32(affected.max.y) + 1, size.y); ++y) {
+			if (is_affected(x, y)) {
+				return true;
 			}
 		}
-	private:
-		void Compare(Point& point, glm::ivec2 index, glm::ivec2 offset) {
-			Point other = Get(index + offset);
-			other.delta += offset;
-			if (other.SquaredDistance() < point.SquaredDistance()) {
-				point = other;
+		return false;
+	};
+	auto row_affected = [&](i32 y) {
+		for (i32 x = glm::max(i32(affected.min.x) - 1, 0); x < glm::min(i32(affected.max.x) + 1, size.x); ++x) {
+			if (is_affected(x, y)) {
+				return true;
 			}
 		}
-		std::vector<Point> points;
-		glm::uvec2 size;
+		return false;
 	};
+	for (bool grew = true; grew;) {
+		grew = false;
+		if (affected.min.x > 0 && column_affected(affected.min.x - 1)) {
+			--affected.min.x;
+			grew = true;
+		}
+		if (affected.max.x < m_size.x && column_affected(affected.max.x)) {
+			++affected.max.x;
+			grew = true;
+		}
+		if (affected.min.y > 0 && row_affected(affected.min.y - 1)) {
+			--affected.min.y;
+			grew = true;
+		}
+		if (affected.max.y < m_size.y && row_affected(affected.max.y)) {
+			++affected.max.y;
+			grew = true;
+		}
+	}
 
-	Grid outside_grid{ size };
-	Grid inside_grid{ size };
-
-	for (u32 y = 0; y < size.y; ++y) {
-		for (u32 x = 0; x < size.x; ++x) {
-			auto material = image[x + y * size.x];
-
-			if (material == c_MaterialEmptySpace) {
-				inside_grid.Set({ x, y }, { {0, 0} });
-			} else {
-				outside_grid.Set({ x, y }, { {0, 0} });
+	// Smoothing writes one pixel around the affected rect and reads one more.
+	// Constant tiles that are written become dense, so all of them is recomputed.
+	PixelRect written = expand(affected, 1);
+	if (m_storage == SdfStorage::Tiled) {
+		const glm::uvec2 min_tile = written.min >> c_SdfTileShift;
+		const glm::uvec2 max_tile = (written.max - 1u) >> c_SdfTileShift;
+		bool has_constant = false;
+		for (u32 y = min_tile.y; y <= max_tile.y; ++y) {
+			for (u32 x = min_tile.x; x <= max_tile.x; ++x) {
+				has_constant |= m_tiles[x + y * m_num_tiles.x].offset == Tile::c_Constant;
 			}
 		}
+		if (has_constant) {
+			written.min = min_tile << c_SdfTileShift;
+			written.max = glm::min((max_tile + 1u) << c_SdfTileShift, m_size);
+		}
 	}
+	const PixelRect recomputed = expand(written, 1);
+	const glm::uvec2 recomputed_size = recomputed.GetSize();
 
-	outside_grid.GenerateSdf();
-	inside_grid.GenerateSdf();
+	// Distance transform of a window around the recomputed pixels. It is exact where the
+	// distances found are closer than any pixel outside the window, otherwise grow the window.
+	// Start from the old distances, they are right unless the edit removed the closest seeds
+	float max_old_distance = 0.f;
+	for (u32 y = recomputed.min.y; y < recomputed.max.y; ++y) {
+		for (u32 x = recomputed.min.x; x < recomputed.max.x; ++x) {
+			max_old_distance = glm::max(max_old_distance, glm::abs(GetDistance({ x, y })));
+		}
+	}
+	std::vector<i32> outside_squared;
+	std::vector<i32> inside_squared;
+	PixelRect window;
+	for (i32 margin = glm::max(16, static_cast<i32>(max_old_distance / c_SdfDistanceScale) + 4);; margin *= 2) {
+		window = expand(recomputed, margin);
+		const glm::uvec2 window_size = window.GetSize();
 
-	//std::vector<float> distances;
-	//distances.resize(size.x * size.y);
-	m_distances.resize(size.x * size.y);
+		std::vector<u8> window_image(window_size.x * window_size.y);
+		for (u32 y = 0; y < window_size.y; ++y) {
+			auto* source = &image[window.min.x + (window.min.y + y) * m_size.x];
+			std::copy(source, source + window_size.x, &window_image[y * window_size.x]);
+		}
+		ComputeSquaredDistances(window_image, window_size, true, outside_squared);
+		ComputeSquaredDistances(window_image, window_size, false, inside_squared);
 
+		if (window_size == m_size) {
+			break;
+		}
 
-	for (u32 y = 0; y < size.y; ++y) {
-		for (u32 x = 0; x < size.x; ++x) {
-			float outside_distance = glm::sqrt(outside_grid.Get({x, y}).SquaredDistance());
-			float inside_distance = glm::sqrt(inside_grid.Get({x, y}).SquaredDistance());
+		bool exact = true;
+		for (u32 y = recomputed.min.y; y < recomputed.max.y && exact; ++y) {
+			for (u32 x = recomputed.min.x; x < recomputed.max.x; ++x) {
+				i64 edge_distance = std::numeric_limits<i32>::max();
+				if (window.min.x > 0) edge_distance = glm::min<i64>(edge_distance, x - window.min.x + 1);
+				if (window.min.y > 0) edge_distance = glm::min<i64>(edge_distance, y - window.min.y + 1);
+				if (window.max.x < m_size.x) edge_distance = glm::min<i64>(edge_distance, window.max.x - x);
+				if (window.max.y < m_size.y) edge_distance = glm::min<i64>(edge_distance, window.max.y - y);
+
+				auto index = (x - window.min.x) + (y - window.min.y) * window_size.x;
+				i64 squared = glm::max(outside_squared[index], inside_squared[index]);
+				if (squared > edge_distance * edge_distance) {
+					exact = false;
+					break;
+				}
+			}
+		}
+		if (exact) {
+			break;
+		}
+	}
+
+	const glm::uvec2 window_size = window.GetSize();
+	std::vector<float> distances(recomputed_size.x * recomputed_size.y);
+	for (u32 y = 0; y < recomputed_size.y; ++y) {
+		for (u32 x = 0; x < recomputed_size.x; ++x) {
+			auto index = (recomputed.min.x - window.min.x + x) + (recomputed.min.y - window.min.y + y) * window_size.x;
+			float outside_distance = glm::sqrt(static_cast<float>(outside_squared[index]));
+			float inside_distance = glm::sqrt(static_cast<float>(inside_squared[index]));
 
 			if (outside_distance > 0.f) {
 				outside_distance -= 0.5f;
@@ -188,66 +586,68 @@ void ShapeSdf::Create(const std::vector<u8>& image, glm::uvec2 size) {
 			if (inside_distance > 0.f) {
 				inside_distance -= 0.5f;
 			}
-			float signed_distance = outside_distance - inside_distance;
-
-			m_distances[x + y * size.x] = signed_distance;
+			distances[x + y * recomputed_size.x] = outside_distance - inside_distance;
 		}
 	}
 
-	auto copy = m_distances;
-
-	m_min_distance = std::numeric_limits<float>::max();
-	m_max_distance = std::numeric_limits<float>::lowest();
+	// Clamping at the edges of the recomputed rect is only used where it is the image edge
+	std::vector<float> smoothed;
+	float unused_min;
+	float unused_max;
+	SmoothDistances(distances, recomputed_size, smoothed, unused_min, unused_max);
 
-	glm::mat3 kernel = {
-		1,2,1,
-		2,4,2,
-		1,2,1,
-		//1,1,1,
-		//1,1,1,
-		//1,1,1,
-	};
-	kernel *= 1.f / 16.f;
-	//kernel *= 1.f / 9.f;
-	for (i32 y = 0; y < size.y; ++y) {
-		for (i32 x = 0; x < size.x; ++x) {
-			float sum = 0.f;
-			for (i32 yo = -1; yo <= 1; ++yo) {
-				for (i32 xo = -1; xo <= 1; ++xo) {
-					auto index = glm::clamp(glm::ivec2(x+xo, y+yo), glm::ivec2(0), glm::ivec2(m_size)-1);
-					sum += kernel[yo+1][xo+1] * copy[index.x + index.y * m_size.x];
-				}
+	float written_min = m_min_distance;
+	float written_max = m_max_distance;
+	for (u32 y = written.min.y; y < written.max.y; ++y) {
+		for (u32 x = written.min.x; x < written.max.x; ++x) {
+			const float distance = smoothed[(x - recomputed.min.x) + (y - recomputed.min.y) * recomputed_size.x];
+			written_min = glm::min(written_min, distance);
+			written_max = glm::max(written_max, distance);
+		}
+	}
+	// Quantized distances would saturate outside the range they were created with, and shapes
+	// created empty have almost no range at all, so the range is fitted to the new distances
+	if (m_format != SdfFormat::Float32 && (written_min < m_min_distance || written_max > m_max_distance)) {
+		std::vector<float> distances;
+		CopyDistances({ glm::uvec2(0), m_size }, distances);
+		for (u32 y = written.min.y; y < written.max.y; ++y) {
+			for (u32 x = written.min.x; x < written.max.x; ++x) {
+				distances[x + y * m_size.x] = smoothed[(x - recomputed.min.x) + (y - recomputed.min.y) * recomputed_size.x];
+			}
+		}
+		Requantize(std::move(distances));
+		// Every quantized distance changed
+		written = { glm::uvec2(0), m_size };
+	} else {
+		m_min_distance = written_min;
+		m_max_distance = written_max;
+		for (u32 y = written.min.y; y < written.max.y; ++y) {
+			for (u32 x = written.min.x; x < written.max.x; ++x) {
+				SetDistance({ x, y }, smoothed[(x - recomputed.min.x) + (y - recomputed.min.y) * recomputed_size.x]);
 			}
-			sum *= 1.f / 9.f;
-
-			m_distances[x + y * m_size.x] = sum;
-
-			m_max_distance = glm::max(sum, m_max_distance);
-			m_min_distance = glm::min(sum, m_min_distance);
 		}
 	}
+	UpdateLevels(written);
 
-	//float range = max_distance - min_distance;
-	//float inverse_range = 1.f / range;
+	// Gradients are taken one pixel to the side and use the next pixel for differences
+	if (!m_gradients.empty()) {
+		UpdateGradients({ glm::uvec2(glm::max(glm::ivec2(written.min) - 2, 0)), glm::min(written.max + 1u, m_size) });
+	}
 
-	//for (u32 y = 0; y < size.y; ++y) {
-	//	for (u32 x = 0; x < size.x; ++x) {
-	//		auto distance = distances[x + y * size.x];
-	//		float normalized = (distance - min_distance) * inverse_range;
-	//		m_distances[x + y * size.x] = glm::round(normalized * 255.f);
-	//	}
-	//}
+	return written;
 }
 
 std::pair<float, glm::vec2> ShapeSdf::GetDistanceAndGradient(glm::vec2 position) const {
 	position *= c_PixelsPerMeter;
 	auto clamped_position = glm::clamp(position, glm::vec2(0), glm::vec2(m_size)-1.0001f);
-	const glm::ivec2 index = glm::floor(clamped_position);
-	const float distance00 = GetDistance(index);
-	const float distance10 = GetDistance(index + glm::ivec2(1,0));
-	const float distance01 = GetDistance(index + glm::ivec2(0,1));
-	const float distance11 = GetDistance(index + glm::ivec2(1,1));
-	const glm::vec2 t = glm::fract(clamped_position);
+	// size - 1.0001 rounds to size - 1 for large shapes
+	const glm::ivec2 index = glm::min(glm::ivec2(glm::floor(clamped_position)), glm::ivec2(m_size) - 2);
+	const glm::vec4 corners = GetCornerDistances(index);
+	const float distance00 = corners.x;
+	const float distance10 = corners.y;
+	const float distance01 = corners.z;
+	const float distance11 = corners.w;
+	const glm::vec2 t = clamped_position - glm::vec2(index);
 	const float distance0 = glm::mix(distance00, distance10, t.x);
 	const float distance1 = glm::mix(distance01, distance11, t.x);
 	float distance = glm::mix(distance0, distance1, t.y);
@@ -256,6 +656,10 @@ std::pair<float, glm::vec2> ShapeSdf::GetDistanceAndGradient(glm::vec2 position)
 	if (position == clamped_position) {
 		gradient = glm::vec2(distance00) - glm::vec2(distance10, distance01);
 		float len = glm::length(gradient);
+		if (len < 0.0001f && m_storage == SdfStorage::Tiled && GetTile(index).offset == Tile::c_Constant) {
+			gradient = GetTile(index).gradient;
+			len = 1.f;
+		}
 		if (len < 0.0001f) {
 			len = 0.0001f;
 		}
@@ -270,6 +674,464 @@ std::pair<float, glm::vec2> ShapeSdf::GetDistanceAndGradient(glm::vec2 position)
 	return { distance, gradient };
 }
 
+void ShapeSdf::GetDistancesAndGradients(u32 count, const float* x, const float* y,
+	float* distances, float* gradient_x, float* gradient_y) const {
+#if defined(__AVX2__)
+	if (m_storage == SdfStorage::Dense && m_format == SdfFormat::Float32 && m_layout == SdfLayout::RowMajor) {
+		const __m256 pixels_per_meter = _mm256_set1_ps(c_PixelsPerMeter);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.f);
+		const __m256 min_length = _mm256_set1_ps(0.0001f);
+		const __m256 max_x = _mm256_set1_ps(m_size.x - 1.0001f);
+		const __m256 max_y = _mm256_set1_ps(m_size.y - 1.0001f);
+		const __m256i max_index_x = _mm256_set1_epi32(m_size.x - 2);
+		const __m256i max_index_y = _mm256_set1_epi32(m_size.y - 2);
+		const __m256i stride = _mm256_set1_epi32(m_size.x);
+		const __m256i lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		auto mix = [&](__m256 a, __m256 b, __m256 t) {
+			return _mm256_add_ps(_mm256_mul_ps(a, _mm256_sub_ps(one, t)), _mm256_mul_ps(b, t));
+		};
+
+		for (u32 i = 0; i < count; i += 8) {
+			// Lanes past count are masked out, they sample position 0
+			const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(count - i), lane_index);
+			const __m256 position_x = _mm256_mul_ps(_mm256_maskload_ps(x + i, mask), pixels_per_meter);
+			const __m256 position_y = _mm256_mul_ps(_mm256_maskload_ps(y + i, mask), pixels_per_meter);
+			const __m256 clamped_x = _mm256_min_ps(_mm256_max_ps(position_x, zero), max_x);
+			const __m256 clamped_y = _mm256_min_ps(_mm256_max_ps(position_y, zero), max_y);
+
+			// Clamped positions are not negative, so truncating is flooring
+			const __m256i index_x = _mm256_min_epi32(_mm256_cvttps_epi32(clamped_x), max_index_x);
+			const __m256i index_y = _mm256_min_epi32(_mm256_cvttps_epi32(clamped_y), max_index_y);
+			const __m256i index = _mm256_add_epi32(index_x, _mm256_mullo_epi32(index_y, stride));
+			const __m256 distance00 = _mm256_i32gather_ps(m_distances.data(), index, 4);
+			const __m256 distance10 = _mm256_i32gather_ps(m_distances.data() + 1, index, 4);
+			const __m256 distance01 = _mm256_i32gather_ps(m_distances.data() + m_size.x, index, 4);
+			const __m256 distance11 = _mm256_i32gather_ps(m_distances.data() + m_size.x + 1, index, 4);
+
+			const __m256 t_x = _mm256_sub_ps(clamped_x, _mm256_cvtepi32_ps(index_x));
+			const __m256 t_y = _mm256_sub_ps(clamped_y, _mm256_cvtepi32_ps(index_y));
+			__m256 distance = mix(mix(distance00, distance10, t_x), mix(distance01, distance11, t_x), t_y);
+
+			const __m256 inside_x = _mm256_sub_ps(distance00, distance10);
+			const __m256 inside_y = _mm256_sub_ps(distance00, distance01);
+			const __m256 inside_length = _mm256_max_ps(min_length,
+				_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(inside_x, inside_x), _mm256_mul_ps(inside_y, inside_y))));
+
+			// Outside the image the gradient points back at it and the distance grows with the length
+			const __m256 outside_x = _mm256_sub_ps(clamped_x, position_x);
+			const __m256 outside_y = _mm256_sub_ps(clamped_y, position_y);
+			const __m256 outside_length = _mm256_sqrt_ps(
+				_mm256_add_ps(_mm256_mul_ps(outside_x, outside_x), _mm256_mul_ps(outside_y, outside_y)));
+			const __m256 outside = _mm256_cmp_ps(outside_length, zero, _CMP_GT_OQ);
+			distance = _mm256_add_ps(distance, outside_length);
+
+			const __m256 length = _mm256_blendv_ps(inside_length, outside_length, outside);
+			const __m256 result_x = _mm256_div_ps(_mm256_blendv_ps(inside_x, outside_x, outside), length);
+			const __m256 result_y = _mm256_div_ps(_mm256_blendv_ps(inside_y, outside_y, outside), length);
+			_mm256_maskstore_ps(distances + i, mask, distance);
+			_mm256_maskstore_ps(gradient_x + i, mask, result_x);
+			_mm256_maskstore_ps(gradient_y + i, mask, result_y);
+		}
+		return;
+	}
+#endif
+	for (u32 i = 0; i < count; ++i) {
+		auto [distance, gradient] = GetDistanceAndGradient(glm::vec2(x[i], y[i]));
+		distances[i] = distance;
+		gradient_x[i] = gradient.x;
+		gradient_y[i] = gradient.y;
+	}
+}
+
+glm::vec2 ShapeSdf::GetSmoothedGradient(glm::vec2 position) const {
+	if (m_gradients.empty()) {
+		return GetSmoothedGradientFromDistances(position);
+	}
+
+	position *= c_PixelsPerMeter;
+	auto clamped_position = glm::clamp(position, glm::vec2(0), glm::vec2(m_size) - 1.0001f);
+	if (position != clamped_position) {
+		return glm::normalize(clamped_position - position);
+	}
+	const glm::ivec2 index = glm::min(glm::ivec2(clamped_position), glm::ivec2(m_size) - 2);
+	const glm::vec2 t = clamped_position - glm::vec2(index);
+	auto gradient_at = [&](u32 x, u32 y) {
+		const i16* gradient = &m_gradients[2 * (x + y * m_size.x)];
+		return glm::vec2(gradient[0], gradient[1]);
+	};
+	glm::vec2 gradient = glm::mix(
+		glm::mix(gradient_at(index.x, index.y), gradient_at(index.x + 1, index.y), t.x),
+		glm::mix(gradient_at(index.x, index.y + 1), gradient_at(index.x + 1, index.y + 1), t.x),
+		t.y);
+	float len = glm::length(gradient);
+	return len > 0.f ? gradient / len : glm::vec2(0.f);
+}
+
+bool ShapeSdf::HasGradients() const {
+	return !m_gradients.empty();
+}
+
+float ShapeSdf::GetDistanceBound(glm::vec2 position, u32 level_index) const {
+	position *= c_PixelsPerMeter;
+	// The shape is inside the image, so the distance from outside is at least the one at the edge
+	auto clamped_position = glm::clamp(position, glm::vec2(0), glm::vec2(m_size) - 1.f);
+	const float outside_distance = glm::length(clamped_position - position) * c_SdfDistanceScale;
+
+	if (level_index == 0) {
+		const glm::ivec2 index = glm::min(glm::ivec2(clamped_position), glm::ivec2(m_size) - 2);
+		return glm::compMin(GetCornerDistances(index)) + outside_distance;
+	}
+	const Level& level = m_levels[level_index - 1];
+	const glm::uvec2 index = glm::min(glm::uvec2(clamped_position) >> level.shift, level.size - 1u);
+	// Anywhere in the block is at most its diagonal away from the pixel the distance came from
+	const float block_diagonal = glm::sqrt(2.f) * static_cast<float>(1u << level.shift);
+	return level.distances[index.x + index.y * level.size.x] - block_diagonal * c_SdfDistanceScale + outside_distance;
+}
+
+u32 ShapeSdf::GetNumLevels() const {
+	return static_cast<u32>(m_levels.size()) + 1;
+}
+
+bool ShapeSdf::IsInsideImage(glm::vec2 position) const {
+	position *= c_PixelsPerMeter;
+	return position == glm::clamp(position, glm::vec2(0), glm::vec2(m_size) - 1.f);
+}
+
 float ShapeSdf::GetDistance(glm::ivec2 index) const {
-	return m_distances[index.x + index.y * m_size.x];
+	if (m_storage == SdfStorage::Dense) {
+		const u32 i = GetDenseIndex(index);
+		switch (m_format) {
+		case SdfFormat::Int16:
+			return m_distances_i16[i] * m_scale + m_bias;
+		case SdfFormat::UInt8:
+			return m_distances_u8[i] * m_scale + m_bias;
+		default:
+			return m_distances[i];
+		}
+	}
+	const Tile& tile = GetTile(index);
+	if (tile.offset == Tile::c_Constant) {
+		return tile.distance;
+	}
+	constexpr i32 mask = c_SdfTileSize - 1;
+	return m_tile_distances[tile.offset + (index.x & mask) + (index.y & mask) * c_SdfTileSize];
+}
+
+void ShapeSdf::CopyDistances(PixelRect rect, std::vector<float>& distances) const {
+	auto size = rect.GetSize();
+	distances.resize(size.x * size.y);
+	for (u32 y = 0; y < size.y; ++y) {
+		if (m_storage == SdfStorage::Dense && m_format == SdfFormat::Float32 && m_layout == SdfLayout::RowMajor) {
+			auto* source = &m_distances[rect.min.x + (rect.min.y + y) * m_size.x];
+			std::copy(source, source + size.x, &distances[y * size.x]);
+		} else {
+			for (u32 x = 0; x < size.x; ++x) {
+				distances[x + y * size.x] = GetDistance(glm::ivec2(rect.min + glm::uvec2(x, y)));
+			}
+		}
+	}
+}
+
+SdfStorage ShapeSdf::GetStorage() const {
+	return m_storage;
+}
+
+SdfFormat ShapeSdf::GetFormat() const {
+	return m_format;
+}
+
+SdfLayout ShapeSdf::GetLayout() const {
+	return m_layout;
+}
+
+SdfMemoryUsage ShapeSdf::GetMemoryUsage() const {
+	SdfMemoryUsage usage;
+	usage.dense_bytes = sizeof(float) * u64(m_size.x) * m_size.y;
+	if (m_storage == SdfStorage::Dense) {
+		usage.bytes = sizeof(float) * m_distances.capacity() + sizeof(i16) * m_distances_i16.capacity()
+			+ sizeof(u8) * m_distances_u8.capacity();
+	} else {
+		usage.bytes = sizeof(Tile) * m_tiles.capacity() + sizeof(float) * m_tile_distances.capacity();
+		usage.num_tiles = static_cast<u32>(m_tiles.size());
+		usage.num_dense_tiles = static_cast<u32>(m_tile_distances.size() / (c_SdfTileSize * c_SdfTileSize));
+	}
+	for (auto& level : m_levels) {
+		usage.level_bytes += sizeof(float) * level.distances.capacity();
+	}
+	usage.gradient_bytes = sizeof(i16) * m_gradients.capacity();
+	usage.bytes += usage.level_bytes + usage.gradient_bytes;
+	return usage;
+}
+
+const void* ShapeSdf::GetDenseData() const {
+	if (m_storage != SdfStorage::Dense || m_layout != SdfLayout::RowMajor) {
+		return nullptr;
+	}
+	switch (m_format) {
+	case SdfFormat::Int16:
+		return m_distances_i16.data();
+	case SdfFormat::UInt8:
+		return m_distances_u8.data();
+	default:
+		return m_distances.data();
+	}
+}
+
+float ShapeSdf::GetQuantizationScale() const {
+	return m_scale;
+}
+
+float ShapeSdf::GetQuantizationBias() const {
+	return m_bias;
+}
+
+void ShapeSdf::CreateDense() {
+	if (m_format == SdfFormat::Float32 && m_layout == SdfLayout::RowMajor) {
+		return;
+	}
+
+	// Bricked layouts pad the image to whole bricks, the padding is never sampled
+	size_t count = m_size.x * m_size.y;
+	if (m_layout == SdfLayout::Bricked) {
+		const glm::uvec2 num_bricks = (m_size + c_SdfBrickSize - 1u) >> c_SdfBrickShift;
+		m_num_bricks_x = num_bricks.x;
+		count = num_bricks.x * num_bricks.y * c_SdfBrickSize * c_SdfBrickSize;
+	}
+
+	auto distances = std::move(m_distances);
+	m_distances = {};
+
+	const float range = glm::max(m_max_distance - m_min_distance, 0.0001f);
+	switch (m_format) {
+	case SdfFormat::Int16:
+		// Centered so the values use -32767 to 32767
+		m_scale = range / 65534.f;
+		m_bias = 0.5f * (m_min_distance + m_max_distance);
+		m_distances_i16.resize(count);
+		break;
+	case SdfFormat::UInt8:
+		m_scale = range / 255.f;
+		m_bias = m_min_distance;
+		m_distances_u8.resize(count);
+		break;
+	default:
+		m_distances.resize(count);
+		break;
+	}
+
+	ParallelFor(m_size.y, 64, [&](u32 begin, u32 end) {
+		for (u32 y = begin; y < end; ++y) {
+			for (u32 x = 0; x < m_size.x; ++x) {
+				SetDistance(glm::ivec2(x, y), distances[x + y * m_size.x]);
+			}
+		}
+	});
+}
+
+void ShapeSdf::Requantize(std::vector<float> distances) {
+	PROFILE_ZONE("ShapeSdf::Requantize");
+
+	auto [min, max] = std::minmax_element(distances.begin(), distances.end());
+	m_min_distance = *min;
+	m_max_distance = *max;
+	m_distances_i16 = {};
+	m_distances_u8 = {};
+	m_distances = std::move(distances);
+	CreateDense();
+}
+
+glm::vec4 ShapeSdf::GetCornerDistances(glm::ivec2 index) const {
+	if (m_storage == SdfStorage::Dense) {
+		const u32 i = GetDenseIndex(index);
+		// Offsets to the pixels at +x and +y
+		u32 step_x = 1;
+		u32 step_y = m_size.x;
+		if (m_layout == SdfLayout::Bricked) {
+			constexpr u32 brick_pixels = c_SdfBrickSize * c_SdfBrickSize;
+			constexpr u32 mask = c_SdfBrickSize - 1;
+			step_x = (index.x & mask) == mask ? brick_pixels - mask : 1;
+			step_y = (index.y & mask) == mask ? m_num_bricks_x * brick_pixels - mask * c_SdfBrickSize : c_SdfBrickSize;
+		}
+		switch (m_format) {
+		case SdfFormat::Int16: {
+			auto* data = &m_distances_i16[i];
+			return glm::vec4(data[0], data[step_x], data[step_y], data[step_x + step_y]) * m_scale + m_bias;
+		}
+		case SdfFormat::UInt8: {
+			auto* data = &m_distances_u8[i];
+			return glm::vec4(data[0], data[step_x], data[step_y], data[step_x + step_y]) * m_scale + m_bias;
+		}
+		default: {
+			auto* data = &m_distances[i];
+			return glm::vec4(data[0], data[step_x], data[step_y], data[step_x + step_y]);
+		}
+		}
+	}
+	return glm::vec4(
+		GetDistance(index),
+		GetDistance(index + glm::ivec2(1, 0)),
+		GetDistance(index + glm::ivec2(0, 1)),
+		GetDistance(index + glm::ivec2(1, 1)));
+}
+
+void ShapeSdf::CreateLevels() {
+	// Tiled sdfs start coarser so the levels stay small next to the tiles
+	m_levels.clear();
+	for (u32 shift = m_storage == SdfStorage::Tiled ? 3 : 1; (glm::compMax(m_size) >> shift) >= 4; ++shift) {
+		Level level;
+		level.shift = shift;
+		level.size = ((m_size - 1u) >> shift) + 1u;
+		level.distances.resize(level.size.x * level.size.y);
+		m_levels.push_back(std::move(level));
+	}
+	UpdateLevels({ glm::uvec2(0), m_size });
+}
+
+void ShapeSdf::UpdateLevels(PixelRect rect) {
+	auto closer = [](float a, float b) {
+		return glm::abs(a) < glm::abs(b) ? a : b;
+	};
+
+	for (size_t i = 0; i < m_levels.size(); ++i) {
+		Level& level = m_levels[i];
+		const glm::uvec2 min = rect.min >> level.shift;
+		const glm::uvec2 max = ((rect.max - 1u) >> level.shift) + 1u;
+
+		// The first level reads the pixels, the others the 2x2 blocks of the level below
+		const Level* source = i > 0 ? &m_levels[i - 1] : nullptr;
+		const u32 block_shift = source ? 1 : level.shift;
+		const glm::uvec2 source_size = source ? source->size : m_size;
+		ParallelFor(max.y - min.y, 16, [&](u32 begin, u32 end) {
+			for (u32 y = min.y + begin; y < min.y + end; ++y) {
+				for (u32 x = min.x; x < max.x; ++x) {
+					const glm::uvec2 block_min = glm::uvec2(x, y) << block_shift;
+					const glm::uvec2 block_max = glm::min(block_min + (1u << block_shift), source_size);
+					float distance = std::numeric_limits<float>::max();
+					for (u32 by = block_min.y; by < block_max.y; ++by) {
+						for (u32 bx = block_min.x; bx < block_max.x; ++bx) {
+							float source_distance = source
+								? source->distances[bx + by * source->size.x]
+								: GetDistance(glm::ivec2(bx, by));
+							distance = closer(distance, source_distance);
+						}
+					}
+					level.distances[x + y * level.size.x] = distance;
+				}
+			}
+		});
+	}
+}
+
+void ShapeSdf::UpdateGradients(PixelRect rect) {
+	ParallelFor(rect.max.y - rect.min.y, 64, [&](u32 begin, u32 end) {
+		for (u32 y = rect.min.y + begin; y < rect.min.y + end; ++y) {
+			for (u32 x = rect.min.x; x < rect.max.x; ++x) {
+				glm::vec2 gradient = GetSmoothedGradientFromDistances(glm::vec2(x, y) * c_PixelSizeMeters);
+				float len = glm::length(gradient);
+				gradient = len > 0.f ? gradient / len : glm::vec2(0.f);
+				m_gradients[2 * (x + y * m_size.x)] = static_cast<i16>(glm::round(gradient.x * 32767.f));
+				m_gradients[2 * (x + y * m_size.x) + 1] = static_cast<i16>(glm::round(gradient.y * 32767.f));
+			}
+		}
+	});
+}
+
+glm::vec2 ShapeSdf::GetSmoothedGradientFromDistances(glm::vec2 position) const {
+	constexpr float c_eps = c_PixelSizeMeters;
+	return 0.25f * (GetDistanceAndGradient(position + glm::vec2(-c_eps, 0)).second
+		+ GetDistanceAndGradient(position + glm::vec2(c_eps, 0)).second
+		+ GetDistanceAndGradient(position + glm::vec2(0, c_eps)).second
+		+ GetDistanceAndGradient(position + glm::vec2(0, -c_eps)).second);
+}
+
+void ShapeSdf::CreateTiles() {
+	m_num_tiles = (m_size + c_SdfTileSize - 1u) >> c_SdfTileShift;
+	m_tiles.assign(m_num_tiles.x * m_num_tiles.y, {});
+	m_tile_distances.clear();
+
+	const float band = c_SdfBandPixels * c_SdfDistanceScale;
+	const glm::ivec2 last = glm::ivec2(m_size) - 1;
+	auto dense_distance = [&](glm::ivec2 index) {
+		index = glm::clamp(index, glm::ivec2(0), last);
+		return m_distances[index.x + index.y * m_size.x];
+	};
+
+	for (u32 tile_y = 0; tile_y < m_num_tiles.y; ++tile_y) {
+		for (u32 tile_x = 0; tile_x < m_num_tiles.x; ++tile_x) {
+			auto& tile = m_tiles[tile_x + tile_y * m_num_tiles.x];
+			const glm::uvec2 min = glm::uvec2(tile_x, tile_y) << c_SdfTileShift;
+			const glm::uvec2 max = glm::min(min + c_SdfTileSize, m_size);
+
+			tile.distance = dense_distance(min);
+			for (u32 y = min.y; y < max.y; ++y) {
+				for (u32 x = min.x; x < max.x; ++x) {
+					float distance = m_distances[x + y * m_size.x];
+					if (glm::abs(distance) < glm::abs(tile.distance)) {
+						tile.distance = distance;
+					}
+				}
+			}
+
+			if (glm::abs(tile.distance) <= band) {
+				tile.offset = static_cast<u32>(m_tile_distances.size());
+				m_tile_distances.resize(m_tile_distances.size() + c_SdfTileSize * c_SdfTileSize, tile.distance);
+				for (u32 y = min.y; y < max.y; ++y) {
+					for (u32 x = min.x; x < max.x; ++x) {
+						m_tile_distances[tile.offset + (x - min.x) + (y - min.y) * c_SdfTileSize] = m_distances[x + y * m_size.x];
+					}
+				}
+			} else {
+				constexpr i32 half = c_SdfTileSize / 2;
+				const glm::ivec2 center = glm::ivec2(min) + half;
+				glm::vec2 gradient(
+					dense_distance(center - glm::ivec2(half, 0)) - dense_distance(center + glm::ivec2(half, 0)),
+					dense_distance(center - glm::ivec2(0, half)) - dense_distance(center + glm::ivec2(0, half)));
+				float len = glm::length(gradient);
+				tile.gradient = len > 0.f ? gradient / len : glm::vec2(0.f);
+			}
+		}
+	}
+
+	m_tile_distances.shrink_to_fit();
+	m_distances.clear();
+	m_distances.shrink_to_fit();
+}
+
+void ShapeSdf::SetDistance(glm::ivec2 index, float distance) {
+	if (m_storage == SdfStorage::Dense) {
+		const u32 i = GetDenseIndex(index);
+		switch (m_format) {
+		case SdfFormat::Int16:
+			m_distances_i16[i] = static_cast<i16>(glm::clamp(glm::round((distance - m_bias) / m_scale), -32767.f, 32767.f));
+			break;
+		case SdfFormat::UInt8:
+			m_distances_u8[i] = static_cast<u8>(glm::clamp(glm::round((distance - m_bias) / m_scale), 0.f, 255.f));
+			break;
+		default:
+			m_distances[i] = distance;
+			break;
+		}
+		return;
+	}
+	Tile& tile = m_tiles[(index.x >> c_SdfTileShift) + (index.y >> c_SdfTileShift) * m_num_tiles.x];
+	if (tile.offset == Tile::c_Constant) {
+		tile.offset = static_cast<u32>(m_tile_distances.size());
+		m_tile_distances.resize(m_tile_distances.size() + c_SdfTileSize * c_SdfTileSize, tile.distance);
+	}
+	constexpr i32 mask = c_SdfTileSize - 1;
+	m_tile_distances[tile.offset + (index.x & mask) + (index.y & mask) * c_SdfTileSize] = distance;
+}
+
+const ShapeSdf::Tile& ShapeSdf::GetTile(glm::ivec2 index) const {
+	return m_tiles[(index.x >> c_SdfTileShift) + (index.y >> c_SdfTileShift) * m_num_tiles.x];
+}
+
+u32 ShapeSdf::GetDenseIndex(glm::ivec2 index) const {
+	if (m_layout == SdfLayout::RowMajor) {
+		return index.x + index.y * m_size.x;
+	}
+	constexpr i32 mask = c_SdfBrickSize - 1;
+	const u32 brick = (index.x >> c_SdfBrickShift) + (index.y >> c_SdfBrickShift) * m_num_bricks_x;
+	return (brick << (2 * c_SdfBrickShift)) + (index.x & mask) + ((index.y & mask) << c_SdfBrickShift);
 }
@@ -3,33 +3,241 @@
 #include <vector>
 #include "util/IntTypes.hpp"
 #include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 #include "ShapeId.hpp"
 
 constexpr u8 c_MaterialEmptySpace = 0;
 
+/// Rectangle of pixels, max is exclusive
+struct PixelRect {
+	glm::uvec2 min{};
+	glm::uvec2 max{};
+
+	glm::uvec2 GetSize() const {
+		return max - min;
+	}
+};
+
+enum class SdfStorage {
+	Dense,
+	/// Only tiles near the surface are stored per pixel, see c_SdfBandPixels
+	Tiled,
+};
+
+enum class SdfFormat {
+	Float32,
+	/// Fixed point with a per shape scale and bias over the min to max distance range.
+	/// Only used by dense storage, tiled sdfs are always Float32.
+	Int16,
+	UInt8,
+};
+
+enum class SdfLayout {
+	RowMajor,
+	/// Dense distances in c_SdfBrickSize squared bricks that are contiguous in memory,
+	/// so the bilinear taps of a sample usually share a cache line. Only used by dense storage.
+	Bricked,
+};
+
+/// Integer sums over solid pixel indices, exact under any number of edits
+struct PixelMoments {
+	u64 count = 0;
+	u64 sum_x = 0;
+	u64 sum_y = 0;
+	u64 sum_xx = 0;
+	u64 sum_yy = 0;
+
+	PixelMoments& operator+=(const PixelMoments& other);
+	PixelMoments& operator-=(const PixelMoments& other);
+	bool operator==(const PixelMoments& other) const = default;
+};
+
+/// Bounds of the solid pixels in meters from their center of mass
+struct SolidBounds {
+	/// Circle around the center of mass, the same for any rotation of the shape
+	float radius = 0.f;
+	/// Box in shape axes, oriented with the shape when it rotates
+	glm::vec2 box_min{};
+	glm::vec2 box_max{};
+};
+
+struct SdfSettings {
+	SdfStorage storage = SdfStorage::Dense;
+	SdfFormat format = SdfFormat::Float32;
+	SdfLayout layout = SdfLayout::RowMajor;
+	/// Store a smoothed unit gradient per pixel for GetSmoothedGradient. Only used by dense storage.
+	bool gradients = false;
+};
+
+constexpr u32 c_SdfTileShift = 5;
+constexpr u32 c_SdfTileSize = 1u << c_SdfTileShift;
+/// Tiles with a distance at most this many pixels from the surface are stored densely
+constexpr float c_SdfBandPixels = 16.f;
+/// A brick of Float32 distances is one 64 byte cache line
+constexpr u32 c_SdfBrickShift = 2;
+constexpr u32 c_SdfBrickSize = 1u << c_SdfBrickShift;
+
+struct SdfMemoryUsage {
+	u64 bytes = 0;
+	u64 level_bytes = 0;
+	u64 gradient_bytes = 0;
+	// What the same shape costs stored densely
+	u64 dense_bytes = 0;
+	u32 num_tiles = 0;
+	u32 num_dense_tiles = 0;
+};
+
 class ShapeSdf {
 public:
-	void Create(const std::vector<u8>& image, glm::uvec2 size);
+	void Create(const std::vector<u8>& image, glm::uvec2 size, SdfSettings settings = {});
 
-	/// Gradient is pointing towards the surface
+	/// Recomputes the distances that can be affected by pixels edited inside edited_pixels,
+	/// returns the rectangle of distances that was written. Min and max distance only widen.
+	/// When new distances fall outside a quantized sdf's range, the range is refitted and the
+	/// whole sdf is rewritten and returned.
+	PixelRect Update(const std::vector<u8>& image, PixelRect edited_pixels);
+
+	/// Gradient is pointing towards the surface.
+	/// Tiled sdfs are only exact inside the band, further out the distance is clamped per tile.
 	std::pair<float, glm::vec2> GetDistanceAndGradient(glm::vec2 position) const;
 	float GetDistance(glm::ivec2 index) const;
-	std::vector<float> m_distances;
+
+	/// GetDistanceAndGradient for count positions, with x and y in separate arrays.
+	/// Dense row major Float32 sdfs are sampled 8 at a time with AVX2 when available.
+	void GetDistancesAndGradients(u32 count, const float* x, const float* y,
+		float* distances, float* gradient_x, float* gradient_y) const;
+
+	/// Average of the gradients one pixel to each side of position, what the contact normals use.
+	/// With a gradient field this is a single bilinear sample of it, renormalized.
+	glm::vec2 GetSmoothedGradient(glm::vec2 position) const;
+	bool HasGradients() const;
+
+	/// Level 0 is the full resolution sdf, coarser levels hold the distance closest to the surface
+	/// in each block of pixels. Returns a distance, in sdf units, that is never larger than the
+	/// one at position, the coarser the level the looser but the cheaper to sample.
+	float GetDistanceBound(glm::vec2 position, u32 level) const;
+	u32 GetNumLevels() const;
+	/// Outside the image the returned distances are not in sdf units
+	bool IsInsideImage(glm::vec2 position) const;
+
+	/// Writes the distances inside rect to distances, row major
+	void CopyDistances(PixelRect rect, std::vector<float>& distances) const;
+
+	SdfStorage GetStorage() const;
+	SdfFormat GetFormat() const;
+	SdfLayout GetLayout() const;
+	SdfMemoryUsage GetMemoryUsage() const;
+
+	/// Row major distances in GetFormat(), nullptr for tiled storage and bricked layout.
+	/// Stored values dequantize as value * scale + bias.
+	const void* GetDenseData() const;
+	float GetQuantizationScale() const;
+	float GetQuantizationBias() const;
 private:
+	struct Level {
+		u32 shift;
+		glm::uvec2 size;
+		std::vector<float> distances;
+	};
+
+	struct Tile {
+		static constexpr u32 c_Constant = ~0u;
+		// Offset into m_tile_distances or c_Constant
+		u32 offset = c_Constant;
+		// Distance closest to the surface in the tile, used for the whole tile when constant
+		float distance = 0.f;
+		// Gradient at the tile center, used where the constant tiles give none
+		glm::vec2 gradient{};
+	};
+
+	void CreateTiles();
+	/// Moves the row major Float32 distances into the dense format and layout
+	void CreateDense();
+	/// Fits the quantized range to the row major Float32 distances and stores them
+	void Requantize(std::vector<float> distances);
+	void CreateLevels();
+	/// Recomputes the coarse level blocks that overlap rect
+	void UpdateLevels(PixelRect rect);
+	/// Recomputes the gradient field inside rect
+	void UpdateGradients(PixelRect rect);
+	glm::vec2 GetSmoothedGradientFromDistances(glm::vec2 position) const;
+	void SetDistance(glm::ivec2 index, float distance);
+	const Tile& GetTile(glm::ivec2 index) const;
+	/// Index into the dense distances in m_layout
+	u32 GetDenseIndex(glm::ivec2 index) const;
+	friend struct ShapePackSerializer;
+	/// Distances at index, index + (1,0), index + (0,1) and index + (1,1)
+	glm::vec4 GetCornerDistances(glm::ivec2 index) const;
+
+	SdfStorage m_storage = SdfStorage::Dense;
+	SdfFormat m_format = SdfFormat::Float32;
+	SdfLayout m_layout = SdfLayout::RowMajor;
 	glm::uvec2 m_size;
 	float m_min_distance;
 	float m_max_distance;
+	float m_scale = 1.f;
+	float m_bias = 0.f;
+
+	// Dense storage, one of them is used depending on m_format
+	u32 m_num_bricks_x = 0;
+	std::vector<float> m_distances;
+	std::vector<i16> m_distances_i16;
+	std::vector<u8> m_distances_u8;
+
+	// Tiled storage
+	glm::uvec2 m_num_tiles{};
+	std::vector<Tile> m_tiles;
+	std::vector<float> m_tile_distances;
+
+	// Levels 1 and up, halving in size
+	std::vector<Level> m_levels;
+
+	// Row major x and y of the smoothed gradient as snorm, empty without a gradient field
+	std::vector<i16> m_gradients;
 };
 
 class Shape {
 public:
+	/// Random shapes, seeded from rand() unless a seed is given
 	Shape();
-	Shape(glm::uvec2 size);
+	Shape(glm::uvec2 size, SdfSettings sdf_settings = {});
+	Shape(glm::uvec2 size, u32 seed, SdfSettings sdf_settings = {});
+	Shape(glm::uvec2 size, std::vector<u8> image, SdfSettings sdf_settings = {});
+
+	/// Noise blob that fades out towards a circle inscribed in the image, the same seed gives the same image
+	static std::vector<u8> GenerateRandomImage(glm::uvec2 size, u32 seed);
 
 	const std::vector<u8>& GetImage() const;
 	const glm::uvec2& GetSize() const;
 
 	u8 GetPixelAt(glm::uvec2 pixel) const;
+	bool IsSolid(glm::uvec2 pixel) const;
+
+	/// One bit per pixel, set where the pixel is not c_MaterialEmptySpace. Rows are
+	/// GetOccupancyStride() words long, pixel x of a row is bit x % 64 of word x / 64.
+	const std::vector<u64>& GetOccupancy() const;
+	u32 GetOccupancyStride() const;
+
+	/// Counted from the occupancy when the shape is created and kept up to date by EditImage
+	u32 GetNumSolidPixels() const;
+	const PixelMoments& GetSolidMoments() const;
+	/// Center of the solid pixels in meters from the shape corner, zero without solid pixels
+	glm::vec2 GetSolidCenter() const;
+	/// Polar second moment of area of the solid pixels around GetSolidCenter, in meters^4
+	float GetSolidSecondMoment() const;
+	/// Moments of the solid pixels inside rect, summed from the occupancy a word at a time
+	PixelMoments CountSolidMoments(PixelRect rect) const;
+
+	/// Convex hull of the solid pixel centers in meters from the shape corner, counter clockwise
+	/// without collinear points and kept up to date by EditImage. The deepest pixel of the shape
+	/// in any direction is one of its vertices, what plane contacts are found from.
+	const std::vector<glm::vec2>& GetConvexHull() const;
+	/// Around GetSolidCenter, from the convex hull and kept up to date by EditImage
+	const SolidBounds& GetSolidBounds() const;
+
+	/// Writes pixels, row major with the size of rect, and updates the sdf around them.
+	/// Returns the rectangle of updated distances.
+	PixelRect EditImage(PixelRect rect, const std::vector<u8>& pixels);
 
 	glm::vec2 GetSizeInMeters() const;
 
@@ -41,11 +249,27 @@ public:
 	ShapeId GetId() const;
 	void SetId(ShapeId);
 private:
-	void GenerateRandomShape();
+	friend struct ShapePackSerializer;
+	// Filled in by ShapePackSerializer
+	struct Empty {};
+	Shape(Empty);
+
+	void CreateOccupancy();
+	/// Rebuilds the occupancy words covering rect from the image
+	void UpdateOccupancy(PixelRect rect);
+	/// From the first and last solid pixel of each row of the occupancy
+	void CreateConvexHull();
+	/// From the convex hull and the solid moments
+	void CreateSolidBounds();
 
 	std::vector<u8> m_image;
 	glm::uvec2 m_size;
-	glm::vec2 m_center_offset;
+	u32 m_occupancy_stride = 0;
+	std::vector<u64> m_occupancy;
+	PixelMoments m_solid_moments;
+	std::vector<glm::vec2> m_convex_hull;
+	SolidBounds m_solid_bounds;
+	glm::vec2 m_center_offset{};
 	ShapeId m_id;
 
 	ShapeSdf m_sdf;
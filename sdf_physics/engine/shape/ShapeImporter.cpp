@@ -0,0 +1,75 @@
+#include "ShapeImporter.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+
+#include "ImageReader.hpp"
+#include "ShapeMetadata.hpp"
+#include "util/ParallelFor.hpp"
+#include "util/Profiler.hpp"
+
+bool ImportShapes(const std::string& path, const ShapeImportSettings& settings, std::vector<ImportedShape>& shapes) {
+	PROFILE_ZONE("ImportShapes");
+
+	ImageReader reader;
+	if (!reader.Open(path)) {
+		return false;
+	}
+	if (settings.max_shape_size == 0) {
+		std::cerr << "ERROR: max shape size has to be positive\n";
+		return false;
+	}
+
+	const glm::uvec2 size = reader.GetSize();
+	const u32 cell_size = settings.max_shape_size;
+	const glm::uvec2 num_cells = (size + cell_size - 1u) / cell_size;
+
+	std::vector<u8> band;
+	std::vector<u8> row;
+	// Files store the top row first, shapes the bottom row
+	for (u32 band_index = 0; band_index < num_cells.y; ++band_index) {
+		const u32 band_top = band_index * cell_size;
+		const u32 band_height = std::min(cell_size, size.y - band_top);
+		band.resize(size_t(size.x) * band_height);
+		for (u32 y = 0; y < band_height; ++y) {
+			if (!reader.ReadRow(row)) {
+				return false;
+			}
+			std::copy(row.begin(), row.end(), band.begin() + size_t(band_height - 1 - y) * size.x);
+		}
+
+		const u32 cell_y = num_cells.y - 1 - band_index;
+		std::vector<std::optional<Shape>> band_shapes(num_cells.x);
+		ParallelFor(num_cells.x, 1, [&](u32 begin, u32 end) {
+			for (u32 cell_x = begin; cell_x < end; ++cell_x) {
+				const u32 min_x = cell_x * cell_size;
+				const glm::uvec2 cell_pixels(std::min(cell_size, size.x - min_x), band_height);
+				const glm::uvec2 shape_size = cell_pixels + 2u;
+
+				std::vector<u8> image(size_t(shape_size.x) * shape_size.y, c_MaterialEmptySpace);
+				bool solid = false;
+				for (u32 y = 0; y < cell_pixels.y; ++y) {
+					const u8* source = band.data() + size_t(y) * size.x + min_x;
+					u8* destination = image.data() + size_t(y + 1) * shape_size.x + 1;
+					std::copy(source, source + cell_pixels.x, destination);
+					solid = solid || std::any_of(source, source + cell_pixels.x, [](u8 material) {
+						return material != c_MaterialEmptySpace;
+					});
+				}
+				if (solid) {
+					band_shapes[cell_x].emplace(shape_size, std::move(image), settings.sdf_settings);
+				}
+			}
+		});
+
+		for (u32 cell_x = 0; cell_x < num_cells.x; ++cell_x) {
+			if (band_shapes[cell_x]) {
+				const glm::uvec2 min(cell_x * cell_size, size.y - band_top - band_height);
+				const glm::vec2 corner = (glm::vec2(min) - 1.f) * c_PixelSizeMeters;
+				shapes.push_back({ glm::uvec2(cell_x, cell_y), corner, std::move(*band_shapes[cell_x]) });
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+#include "util/IntTypes.hpp"
+#include "Shape.hpp"
+
+struct ShapeImportSettings {
+	/// Sources wider or taller than this are split into a grid of shapes at most this size
+	u32 max_shape_size = 1024;
+	SdfSettings sdf_settings;
+};
+
+struct ImportedShape {
+	/// Column and row in the grid the source was split into, row 0 at the bottom
+	glm::uvec2 cell;
+	/// Lower left corner of the shape in meters from the lower left corner of the source
+	glm::vec2 corner;
+	Shape shape;
+};
+
+/// Streams a PGM or PNG with ImageReader and builds a shape for every grid cell that has solid
+/// pixels, pixel values are the materials. The rows of one band of cells are all that is held
+/// of the source, the sdfs of a band are built together on the ParallelFor workers before the
+/// next band is read. Each shape gets a one pixel empty border so cut edges have a surface.
+/// Prints an error and returns false if the source can not be read.
+bool ImportShapes(const std::string& path, const ShapeImportSettings& settings, std::vector<ImportedShape>& shapes);
@@ -1,5 +1,16 @@
 #include "ShapeManager.hpp"
 
+#include <algorithm>
+#include <iostream>
+#include "engine/SystemManager.hpp"
+#include "ShapePack.hpp"
+#include "util/ParallelFor.hpp"
+#include "util/Profiler.hpp"
+
+ShapeManager::ShapeManager(SystemManager& system_manager) {
+	system_manager.OnUpdate().connect<&ShapeManager::Update>(this);
+}
+
 Shape& ShapeManager::CreateShape() {
 	Shape shape;
 	return CreateShape(std::move(shape));
@@ -12,8 +23,221 @@ Shape& ShapeManager::CreateShape(Shape shape) {
 	return iter.first->second;
 }
 
+ShapeId ShapeManager::CreateShapeAsync(std::function<Shape()> cook) {
+	auto id = m_id_generator.Generate();
+	auto cooking = std::make_shared<CookingShape>();
+	m_cooking_shapes.emplace_back(id, cooking);
+
+	RunInBackground([cooking, cook = std::move(cook)]() {
+		cooking->shape.emplace(cook());
+		cooking->done.store(true, std::memory_order_release);
+		cooking->done.notify_all();
+	});
+	return id;
+}
+
+bool ShapeManager::IsCooking(ShapeId id) const {
+	return std::any_of(m_cooking_shapes.begin(), m_cooking_shapes.end(), [id](auto& cooking) {
+		return cooking.first == id;
+	});
+}
+
+void ShapeManager::PublishCookedShapes() {
+	if (m_cooking_shapes.empty()) {
+		return;
+	}
+	PROFILE_ZONE("ShapeManager::PublishCookedShapes");
+
+	// Taken out first, listeners can start cooking more shapes
+	std::vector<std::pair<ShapeId, std::shared_ptr<CookingShape>>> cooked;
+	auto is_done = [](auto& cooking) {
+		return cooking.second->done.load(std::memory_order_acquire);
+	};
+	std::copy_if(m_cooking_shapes.begin(), m_cooking_shapes.end(), std::back_inserter(cooked), is_done);
+	m_cooking_shapes.erase(std::remove_if(m_cooking_shapes.begin(), m_cooking_shapes.end(), is_done), m_cooking_shapes.end());
+
+	for (auto& [id, cooking] : cooked) {
+		AddCookedShape(id, std::move(*cooking->shape));
+	}
+}
+
+void ShapeManager::FinishCooking() {
+	PROFILE_ZONE("ShapeManager::FinishCooking");
+	for (auto& [id, cooking] : m_cooking_shapes) {
+		cooking->done.wait(false, std::memory_order_acquire);
+	}
+	PublishCookedShapes();
+}
+
+void ShapeManager::FinishCooking(ShapeId id) {
+	auto iter = std::find_if(m_cooking_shapes.begin(), m_cooking_shapes.end(), [id](auto& cooking) {
+		return cooking.first == id;
+	});
+	if (iter == m_cooking_shapes.end()) {
+		return;
+	}
+	PROFILE_ZONE("ShapeManager::FinishCooking");
+	iter->second->done.wait(false, std::memory_order_acquire);
+	PublishCookedShapes();
+}
+
+entt::sink<void(ShapeId)> ShapeManager::OnShapeCooked() {
+	return { m_on_shape_cooked };
+}
+
+void ShapeManager::Update(float) {
+	PublishCookedShapes();
+}
+
+void ShapeManager::AddCookedShape(ShapeId id, Shape shape) {
+	auto iter = m_shapes.emplace(id, std::move(shape));
+	iter.first->second.SetId(id);
+	m_on_shape_cooked.publish(id);
+}
+
+namespace {
+
+size_t HashImage(glm::uvec2 size, const std::vector<u8>& image) {
+	return robin_hood::hash_bytes(image.data(), image.size()) ^ robin_hood::hash_int((u64(size.x) << 32) | size.y);
+}
+
+bool IsSameSdfSettings(const SdfSettings& left, const SdfSettings& right) {
+	return left.storage == right.storage && left.format == right.format
+		&& left.layout == right.layout && left.gradients == right.gradients;
+}
+
+}
+
+ShapeId ShapeManager::CreateSharedShape(glm::uvec2 size, std::vector<u8> image, SdfSettings sdf_settings) {
+	const size_t hash = HashImage(size, image);
+	if (auto bucket = m_shared_shapes_by_hash.find(hash); bucket != m_shared_shapes_by_hash.end()) {
+		for (auto id : bucket->second) {
+			auto& shared = m_shared_shapes.at(id);
+			auto& shape = m_shapes.at(id);
+			if (IsSameSdfSettings(shared.sdf_settings, sdf_settings) && shape.GetSize() == size && shape.GetImage() == image) {
+				++shared.num_references;
+				return id;
+			}
+		}
+	}
+
+	auto id = CreateShape(Shape(size, std::move(image), sdf_settings)).GetId();
+	m_shared_shapes.emplace(id, SharedShape{ hash, sdf_settings, 1 });
+	m_shared_shapes_by_hash[hash].push_back(id);
+	return id;
+}
+
+bool ShapeManager::AddShapeReference(ShapeId id) {
+	if (auto iter = m_shared_shapes.find(id); iter != m_shared_shapes.end()) {
+		++iter->second.num_references;
+		return true;
+	}
+	std::cout << "ERROR: shape " << id.Value() << " is not shared\n";
+	return false;
+}
+
+bool ShapeManager::ReleaseShape(ShapeId id) {
+	auto iter = m_shared_shapes.find(id);
+	if (iter == m_shared_shapes.end()) {
+		std::cout << "ERROR: shape " << id.Value() << " is not shared\n";
+		return false;
+	}
+	if (--iter->second.num_references == 0) {
+		DeleteShape(id);
+	}
+	return true;
+}
+
+u32 ShapeManager::GetNumSharedShapes() const {
+	return static_cast<u32>(m_shared_shapes.size());
+}
+
+void ShapeManager::ForgetSharedImage(ShapeId id) {
+	auto iter = m_shared_shapes.find(id);
+	if (iter == m_shared_shapes.end()) {
+		return;
+	}
+	if (auto bucket = m_shared_shapes_by_hash.find(iter->second.hash); bucket != m_shared_shapes_by_hash.end()) {
+		auto& ids = bucket->second;
+		ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+		if (ids.empty()) {
+			m_shared_shapes_by_hash.erase(bucket);
+		}
+	}
+}
+
 bool ShapeManager::DeleteShape(ShapeId id) {
-	return m_shapes.erase(id) != 0;
+	auto cooking = std::find_if(m_cooking_shapes.begin(), m_cooking_shapes.end(), [id](auto& cooking) {
+		return cooking.first == id;
+	});
+	if (cooking != m_cooking_shapes.end()) {
+		m_cooking_shapes.erase(cooking);
+		return true;
+	}
+	if (auto shared = m_shared_shapes.find(id); shared != m_shared_shapes.end() && shared->second.num_references > 0) {
+		std::cout << "ERROR: shared shape " << id.Value() << " still has " << shared->second.num_references
+			<< " references, release them instead\n";
+		return false;
+	}
+	ForgetSharedImage(id);
+	m_shared_shapes.erase(id);
+	if (m_shapes.erase(id) == 0) {
+		return false;
+	}
+	m_on_shape_deleted.publish(id);
+	return true;
+}
+
+entt::sink<void(ShapeId)> ShapeManager::OnShapeDeleted() {
+	return { m_on_shape_deleted };
+}
+
+std::vector<ShapeId> ShapeManager::LoadShapePack(const std::string& path) {
+	PROFILE_ZONE("ShapeManager::LoadShapePack");
+	std::vector<Shape> shapes;
+	if (!ReadShapePack(path, shapes)) {
+		return {};
+	}
+	std::vector<ShapeId> ids;
+	ids.reserve(shapes.size());
+	for (auto& shape : shapes) {
+		ids.push_back(CreateShape(std::move(shape)).GetId());
+	}
+	return ids;
+}
+
+bool ShapeManager::EditShape(ShapeId id, PixelRect rect, const std::vector<u8>& pixels) {
+	auto* shape = GetShape(id);
+	if (!shape) {
+		return false;
+	}
+	auto& size = shape->GetSize();
+	auto rect_size = rect.GetSize();
+	if (rect.max.x > size.x || rect.max.y > size.y || rect.min.x >= rect.max.x || rect.min.y >= rect.max.y
+		|| pixels.size() != rect_size.x * rect_size.y) {
+		std::cout << "ERROR: invalid edit of shape " << id.Value() << "\n";
+		return false;
+	}
+
+	ShapeEdit edit;
+	edit.shape_id = id;
+	edit.pixels = rect;
+	edit.previous_pixels.reserve(pixels.size());
+	glm::uvec2 i;
+	for (i.y = rect.min.y; i.y < rect.max.y; ++i.y) {
+		for (i.x = rect.min.x; i.x < rect.max.x; ++i.x) {
+			edit.previous_pixels.push_back(shape->GetPixelAt(i));
+		}
+	}
+	edit.distances = shape->EditImage(rect, pixels);
+	ForgetSharedImage(id);
+
+	m_on_shape_edited.publish(edit);
+	return true;
+}
+
+entt::sink<void(const ShapeEdit&)> ShapeManager::OnShapeEdited() {
+	return { m_on_shape_edited };
 }
 
 Shape* ShapeManager::GetShape(ShapeId id) {
@@ -33,3 +257,24 @@ const Shape* ShapeManager::GetShape(ShapeId id) const {
 bool ShapeManager::HasShape(ShapeId id) const {
 	return m_shapes.contains(id);
 }
+
+void ShapeManager::WriteMemoryReport(std::ostream& out) const {
+	out << "shape,width,height,storage,image_bytes,sdf_bytes,dense_sdf_bytes,dense_tiles,tiles\n";
+	u64 total_image_bytes = 0;
+	u64 total_sdf_bytes = 0;
+	u64 total_dense_sdf_bytes = 0;
+	for (auto& [id, shape] : m_shapes) {
+		auto& size = shape.GetSize();
+		auto& sdf = shape.GetSdf();
+		auto usage = sdf.GetMemoryUsage();
+		u64 image_bytes = shape.GetImage().capacity();
+		out << id.Value() << "," << size.x << "," << size.y << ","
+			<< (sdf.GetStorage() == SdfStorage::Tiled ? "tiled" : "dense") << ","
+			<< image_bytes << "," << usage.bytes << "," << usage.dense_bytes << ","
+			<< usage.num_dense_tiles << "," << usage.num_tiles << "\n";
+		total_image_bytes += image_bytes;
+		total_sdf_bytes += usage.bytes;
+		total_dense_sdf_bytes += usage.dense_bytes;
+	}
+	out << "total,,,," << total_image_bytes << "," << total_sdf_bytes << "," << total_dense_sdf_bytes << ",,\n";
+}
@@ -1,22 +1,110 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <entt/signal/sigh.hpp>
 #include <robin_hood/robin_hood.h>
 #include "engine/System.hpp"
 #include "ShapeId.hpp"
 #include "Shape.hpp"
 
+struct ShapeEdit {
+	ShapeId shape_id;
+	PixelRect pixels;
+	// Contents of pixels before the edit, row major
+	std::vector<u8> previous_pixels;
+	// Distances that were recomputed
+	PixelRect distances;
+};
+
+class SystemManager;
+
 class ShapeManager final : public System {
 public:
+	ShapeManager(SystemManager& system_manager);
+
 	Shape& CreateShape();
 	Shape& CreateShape(Shape shape);
 
+	/// Calls cook on a background thread, where the image, sdf and mass sums are built. The id is
+	/// reserved right away, the shape is added and OnShapeCooked published on the first update
+	/// after cooking finished. Deleting the id while cooking drops the result.
+	ShapeId CreateShapeAsync(std::function<Shape()> cook);
+	bool IsCooking(ShapeId id) const;
+	/// Adds the shapes that finished cooking, done at the start of every update
+	void PublishCookedShapes();
+	/// Waits for every shape that is cooking and publishes them
+	void FinishCooking();
+	/// Waits for one shape and publishes every shape that is done
+	void FinishCooking(ShapeId id);
+
+	entt::sink<void(ShapeId)> OnShapeCooked();
+
+	/// Returns the shape with the same size, image and sdf settings if one was created this way,
+	/// otherwise creates it. Either way the caller holds one reference, given back with ReleaseShape.
+	ShapeId CreateSharedShape(glm::uvec2 size, std::vector<u8> image, SdfSettings sdf_settings = {});
+	/// One more reference to a shared shape, for another owner
+	bool AddShapeReference(ShapeId id);
+	/// Deletes a shared shape when its last reference is released
+	bool ReleaseShape(ShapeId id);
+	u32 GetNumSharedShapes() const;
+
+	/// Shared shapes are only deleted by ReleaseShape, this refuses them while they have
+	/// references. Other shapes have no reference count and are deleted right away, even
+	/// while entities still hold their id. Systems treat a missing shape as no shape, so
+	/// PhysicsSystem skips the bodies of deleted shapes.
 	bool DeleteShape(ShapeId id);
+	entt::sink<void(ShapeId)> OnShapeDeleted();
+
+	/// Adds the shapes of a pack written by sdf_physics_cooker, in pack order. Empty on error.
+	std::vector<ShapeId> LoadShapePack(const std::string& path);
+
+	/// Writes pixels into the shape image and updates its sdf incrementally, then notifies OnShapeEdited.
+	/// Every owner of a shared shape sees the edit, and it is no longer returned for its old image.
+	bool EditShape(ShapeId id, PixelRect rect, const std::vector<u8>& pixels);
+
+	entt::sink<void(const ShapeEdit&)> OnShapeEdited();
 
 	Shape* GetShape(ShapeId id);
 	const Shape* GetShape(ShapeId id) const;
 
 	bool HasShape(ShapeId id) const;
+
+	/// One csv line per shape with the bytes used by its image and sdf
+	void WriteMemoryReport(std::ostream& out) const;
 private:
+	// Shared with the background thread, which only writes shape and then done
+	struct CookingShape {
+		std::optional<Shape> shape;
+		std::atomic<bool> done = false;
+	};
+
+	struct SharedShape {
+		size_t hash;
+		SdfSettings sdf_settings;
+		u32 num_references;
+	};
+
+	void Update(float dt);
+	void AddCookedShape(ShapeId id, Shape shape);
+	void ForgetSharedImage(ShapeId id);
+
 	robin_hood::unordered_map<ShapeId, Shape> m_shapes;
 	TypeSafeIdGenerator<ShapeId> m_id_generator;
+
+	// In the order they were started
+	std::vector<std::pair<ShapeId, std::shared_ptr<CookingShape>>> m_cooking_shapes;
+
+	robin_hood::unordered_map<ShapeId, SharedShape> m_shared_shapes;
+	// Hash of size and image, several shapes when they collide
+	robin_hood::unordered_map<size_t, std::vector<ShapeId>> m_shared_shapes_by_hash;
+
+	entt::sigh<void(const ShapeEdit&)> m_on_shape_edited;
+	entt::sigh<void(ShapeId)> m_on_shape_cooked;
+	entt::sigh<void(ShapeId)> m_on_shape_deleted;
 };
\ No newline at end of file
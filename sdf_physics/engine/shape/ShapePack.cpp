@@ -0,0 +1,291 @@
+#include "ShapePack.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "util/MappedFile.hpp"
+#include "util/ParallelFor.hpp"
+#include "util/Profiler.hpp"
+
+/// Friend of Shape and ShapeSdf, moves their members in and out of packs
+struct ShapePackSerializer {
+	static constexpr u32 c_TileBytes = sizeof(ShapeSdf::Tile);
+
+	struct Chunk {
+		const void* data;
+		u64 bytes;
+	};
+
+	class Writer {
+	public:
+		Writer(u64 offset) : m_offset(offset) {}
+
+		template<typename T>
+		ShapePackRange Add(const std::vector<T>& values) {
+			return Add(values.data(), values.size() * sizeof(T));
+		}
+
+		ShapePackRange Add(const void* data, u64 bytes) {
+			if (bytes == 0) {
+				return {};
+			}
+			m_offset = (m_offset + c_ShapePackAlignment - 1) / c_ShapePackAlignment * c_ShapePackAlignment;
+			ShapePackRange range{ m_offset, bytes };
+			m_chunks.push_back({ data, bytes });
+			m_offset += bytes;
+			return range;
+		}
+
+		const std::vector<Chunk>& GetChunks() const {
+			return m_chunks;
+		}
+
+		u64 GetSize() const {
+			return m_offset;
+		}
+	private:
+		u64 m_offset;
+		std::vector<Chunk> m_chunks;
+	};
+
+	static ShapePackEntry Write(const Shape& shape, Writer& writer, std::vector<ShapePackLevel>& levels) {
+		auto& sdf = shape.m_sdf;
+		ShapePackEntry entry;
+		entry.width = shape.m_size.x;
+		entry.height = shape.m_size.y;
+		entry.storage = static_cast<u32>(sdf.m_storage);
+		entry.format = static_cast<u32>(sdf.m_format);
+		entry.layout = static_cast<u32>(sdf.m_layout);
+		entry.num_bricks_x = sdf.m_num_bricks_x;
+		entry.num_tiles_x = sdf.m_num_tiles.x;
+		entry.num_tiles_y = sdf.m_num_tiles.y;
+		entry.min_distance = sdf.m_min_distance;
+		entry.max_distance = sdf.m_max_distance;
+		entry.scale = sdf.m_scale;
+		entry.bias = sdf.m_bias;
+		entry.occupancy_stride = shape.m_occupancy_stride;
+		entry.solid_moments = shape.m_solid_moments;
+
+		entry.image = writer.Add(shape.m_image);
+		entry.occupancy = writer.Add(shape.m_occupancy);
+		entry.distances = writer.Add(sdf.m_distances);
+		entry.distances_i16 = writer.Add(sdf.m_distances_i16);
+		entry.distances_u8 = writer.Add(sdf.m_distances_u8);
+		entry.tiles = writer.Add(sdf.m_tiles);
+		entry.tile_distances = writer.Add(sdf.m_tile_distances);
+		entry.gradients = writer.Add(sdf.m_gradients);
+
+		for (auto& level : sdf.m_levels) {
+			ShapePackLevel packed;
+			packed.shift = level.shift;
+			packed.width = level.size.x;
+			packed.height = level.size.y;
+			packed.distances = writer.Add(level.distances);
+			levels.push_back(packed);
+		}
+		entry.num_levels = static_cast<u32>(sdf.m_levels.size());
+		entry.levels = writer.Add(levels);
+		return entry;
+	}
+
+	static bool IsInFile(const ShapePackRange& range, u64 file_bytes) {
+		return range.offset <= file_bytes && range.bytes <= file_bytes - range.offset;
+	}
+
+	template<typename T>
+	static bool Read(const u8* file, u64 file_bytes, const ShapePackRange& range, u64 count, std::vector<T>& values) {
+		if (!IsInFile(range, file_bytes) || range.bytes != count * sizeof(T)) {
+			return false;
+		}
+		values.resize(count);
+		if (count > 0) {
+			std::memcpy(values.data(), file + range.offset, range.bytes);
+		}
+		return true;
+	}
+
+	static bool Read(const u8* file, u64 file_bytes, const ShapePackEntry& entry, Shape& shape) {
+		const glm::uvec2 size(entry.width, entry.height);
+		if (size.x == 0 || size.y == 0 || entry.storage > static_cast<u32>(SdfStorage::Tiled)
+			|| entry.format > static_cast<u32>(SdfFormat::UInt8) || entry.layout > static_cast<u32>(SdfLayout::Bricked)) {
+			return false;
+		}
+		const u64 num_pixels = u64(size.x) * size.y;
+
+		shape.m_size = size;
+		shape.m_occupancy_stride = entry.occupancy_stride;
+		shape.m_solid_moments = entry.solid_moments;
+		if (entry.occupancy_stride != (size.x + 63) / 64
+			|| !Read(file, file_bytes, entry.image, num_pixels, shape.m_image)
+			|| !Read(file, file_bytes, entry.occupancy, u64(entry.occupancy_stride) * size.y, shape.m_occupancy)) {
+			return false;
+		}
+		shape.CreateConvexHull();
+		shape.CreateSolidBounds();
+
+		auto& sdf = shape.m_sdf;
+		sdf.m_storage = static_cast<SdfStorage>(entry.storage);
+		sdf.m_format = static_cast<SdfFormat>(entry.format);
+		sdf.m_layout = static_cast<SdfLayout>(entry.layout);
+		sdf.m_size = size;
+		sdf.m_min_distance = entry.min_distance;
+		sdf.m_max_distance = entry.max_distance;
+		sdf.m_scale = entry.scale;
+		sdf.m_bias = entry.bias;
+		sdf.m_num_bricks_x = entry.num_bricks_x;
+		sdf.m_num_tiles = glm::uvec2(entry.num_tiles_x, entry.num_tiles_y);
+
+		// The counts the samplers index with, anything else in the pack is corrupt
+		u64 dense_count = sdf.m_storage == SdfStorage::Dense ? num_pixels : 0;
+		if (sdf.m_storage == SdfStorage::Dense && sdf.m_layout == SdfLayout::Bricked) {
+			const glm::uvec2 num_bricks = (size + c_SdfBrickSize - 1u) >> c_SdfBrickShift;
+			if (entry.num_bricks_x != num_bricks.x) {
+				return false;
+			}
+			dense_count = u64(num_bricks.x) * num_bricks.y * c_SdfBrickSize * c_SdfBrickSize;
+		}
+		auto count_for = [&](SdfFormat format, const ShapePackRange& range, u64 element_bytes) {
+			return sdf.m_format == format ? dense_count : range.bytes / element_bytes;
+		};
+		if (!Read(file, file_bytes, entry.distances, count_for(SdfFormat::Float32, entry.distances, sizeof(float)), sdf.m_distances)
+			|| !Read(file, file_bytes, entry.distances_i16, count_for(SdfFormat::Int16, entry.distances_i16, sizeof(i16)), sdf.m_distances_i16)
+			|| !Read(file, file_bytes, entry.distances_u8, count_for(SdfFormat::UInt8, entry.distances_u8, sizeof(u8)), sdf.m_distances_u8)) {
+			return false;
+		}
+
+		const u64 num_tiles = sdf.m_storage == SdfStorage::Tiled ? u64(sdf.m_num_tiles.x) * sdf.m_num_tiles.y : 0;
+		if (sdf.m_storage == SdfStorage::Tiled && sdf.m_num_tiles != (size + c_SdfTileSize - 1u) >> c_SdfTileShift) {
+			return false;
+		}
+		constexpr u64 c_TileDistances = c_SdfTileSize * c_SdfTileSize;
+		if (!Read(file, file_bytes, entry.tiles, num_tiles, sdf.m_tiles)
+			|| entry.tile_distances.bytes % (c_TileDistances * sizeof(float)) != 0
+			|| !Read(file, file_bytes, entry.tile_distances, entry.tile_distances.bytes / sizeof(float), sdf.m_tile_distances)) {
+			return false;
+		}
+		for (auto& tile : sdf.m_tiles) {
+			if (tile.offset != ShapeSdf::Tile::c_Constant && tile.offset + c_TileDistances > sdf.m_tile_distances.size()) {
+				return false;
+			}
+		}
+
+		const u64 num_gradients = entry.gradients.bytes == 0 ? 0 : 2 * num_pixels;
+		if (!Read(file, file_bytes, entry.gradients, num_gradients, sdf.m_gradients)) {
+			return false;
+		}
+
+		std::vector<ShapePackLevel> levels;
+		if (!Read(file, file_bytes, entry.levels, entry.num_levels, levels)) {
+			return false;
+		}
+		sdf.m_levels.resize(levels.size());
+		for (size_t i = 0; i < levels.size(); ++i) {
+			auto& level = sdf.m_levels[i];
+			level.shift = levels[i].shift;
+			level.size = glm::uvec2(levels[i].width, levels[i].height);
+			if (level.shift >= 32 || level.size != ((size - 1u) >> level.shift) + 1u
+				|| !Read(file, file_bytes, levels[i].distances, u64(level.size.x) * level.size.y, level.distances)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static Shape CreateEmpty() {
+		return Shape(Shape::Empty{});
+	}
+};
+
+bool WriteShapePack(const std::string& path, const std::vector<const Shape*>& shapes) {
+	PROFILE_ZONE("WriteShapePack");
+
+	ShapePackHeader header;
+	header.num_shapes = static_cast<u32>(shapes.size());
+	header.tile_bytes = ShapePackSerializer::c_TileBytes;
+
+	std::vector<ShapePackEntry> entries;
+	std::vector<std::vector<ShapePackLevel>> levels(shapes.size());
+	ShapePackSerializer::Writer writer(sizeof(ShapePackHeader) + shapes.size() * sizeof(ShapePackEntry));
+	for (size_t i = 0; i < shapes.size(); ++i) {
+		entries.push_back(ShapePackSerializer::Write(*shapes[i], writer, levels[i]));
+	}
+	header.file_bytes = writer.GetSize();
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cerr << "ERROR: could not open " << path << " for writing\n";
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ShapePackEntry));
+
+	u64 offset = sizeof(ShapePackHeader) + entries.size() * sizeof(ShapePackEntry);
+	const char padding[c_ShapePackAlignment] = {};
+	for (auto& chunk : writer.GetChunks()) {
+		const u64 aligned = (offset + c_ShapePackAlignment - 1) / c_ShapePackAlignment * c_ShapePackAlignment;
+		file.write(padding, aligned - offset);
+		file.write(static_cast<const char*>(chunk.data), chunk.bytes);
+		offset = aligned + chunk.bytes;
+	}
+
+	if (!file) {
+		std::cerr << "ERROR: could not write " << path << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool ReadShapePack(const std::string& path, std::vector<Shape>& shapes) {
+	PROFILE_ZONE("ReadShapePack");
+
+	MappedFile file;
+	if (!file.Open(path)) {
+		return false;
+	}
+	const u8* data = file.GetData();
+	const u64 file_bytes = file.GetSize();
+
+	ShapePackHeader header;
+	if (file_bytes < sizeof(header)) {
+		std::cerr << "ERROR: " << path << " is not a shape pack\n";
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != c_ShapePackMagic) {
+		std::cerr << "ERROR: " << path << " is not a shape pack\n";
+		return false;
+	}
+	if (header.version != c_ShapePackVersion || header.tile_bytes != ShapePackSerializer::c_TileBytes) {
+		std::cerr << "ERROR: " << path << " is shape pack version " << header.version << ", expected " << c_ShapePackVersion << "\n";
+		return false;
+	}
+	if (header.file_bytes != file_bytes || (file_bytes - sizeof(header)) / sizeof(ShapePackEntry) < header.num_shapes) {
+		std::cerr << "ERROR: " << path << " is truncated\n";
+		return false;
+	}
+
+	std::vector<ShapePackEntry> entries(header.num_shapes);
+	std::memcpy(entries.data(), data + sizeof(header), entries.size() * sizeof(ShapePackEntry));
+
+	const size_t first = shapes.size();
+	for (u32 i = 0; i < header.num_shapes; ++i) {
+		shapes.push_back(ShapePackSerializer::CreateEmpty());
+	}
+
+	// Copying touches every page once, spread over the workers
+	std::vector<u8> valid(header.num_shapes, 0);
+	ParallelFor(header.num_shapes, 16, [&](u32 begin, u32 end) {
+		for (u32 i = begin; i < end; ++i) {
+			valid[i] = ShapePackSerializer::Read(data, file_bytes, entries[i], shapes[first + i]);
+		}
+	});
+
+	if (auto invalid = std::find(valid.begin(), valid.end(), 0); invalid != valid.end()) {
+		std::cerr << "ERROR: shape " << invalid - valid.begin() << " in " << path << " is corrupt\n";
+		shapes.resize(first);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "util/IntTypes.hpp"
+#include "Shape.hpp"
+
+// Shape pack layout, little endian and in the layout of the structs below:
+// ShapePackHeader, num_shapes ShapePackEntry, then the data ranges, each starting on a
+// c_ShapePackAlignment boundary. Tiles are stored as ShapeSdf keeps them in memory, so a pack
+// is only read by the same build layout it was written with, the version changes with it.
+constexpr u32 c_ShapePackMagic = 0x50464453; // "SDFP"
+constexpr u32 c_ShapePackVersion = 2;
+constexpr u64 c_ShapePackAlignment = 64;
+
+struct ShapePackRange {
+	u64 offset = 0;
+	u64 bytes = 0;
+};
+
+struct ShapePackHeader {
+	u32 magic = c_ShapePackMagic;
+	u32 version = c_ShapePackVersion;
+	u32 num_shapes = 0;
+	u32 tile_bytes = 0;
+	u64 file_bytes = 0;
+};
+
+struct ShapePackLevel {
+	u32 shift = 0;
+	u32 width = 0;
+	u32 height = 0;
+	u32 unused = 0;
+	ShapePackRange distances;
+};
+
+struct ShapePackEntry {
+	u32 width = 0;
+	u32 height = 0;
+	u32 storage = 0;
+	u32 format = 0;
+	u32 layout = 0;
+	u32 num_bricks_x = 0;
+	u32 num_tiles_x = 0;
+	u32 num_tiles_y = 0;
+	float min_distance = 0.f;
+	float max_distance = 0.f;
+	float scale = 1.f;
+	float bias = 0.f;
+	u32 occupancy_stride = 0;
+	u32 num_levels = 0;
+	PixelMoments solid_moments;
+	ShapePackRange image;
+	ShapePackRange occupancy;
+	ShapePackRange distances;
+	ShapePackRange distances_i16;
+	ShapePackRange distances_u8;
+	ShapePackRange tiles;
+	ShapePackRange tile_distances;
+	// ShapePackLevel per level
+	ShapePackRange levels;
+	ShapePackRange gradients;
+};
+
+/// Writes the shapes with their finished sdfs, so reading them back needs no distance transform
+bool WriteShapePack(const std::string& path, const std::vector<const Shape*>& shapes);
+
+/// Maps the pack and copies the shapes out of it, in the order they were written.
+/// Prints an error and returns false if the pack is missing, truncated or of another version.
+bool ReadShapePack(const std::string& path, std::vector<Shape>& shapes);
@@ -11,6 +11,7 @@
 #include "ShapeTextureManager.hpp"
 #include "engine/shape/ShapeMetadata.hpp"
 #include "DebugDrawing.hpp"
+#include "util/Profiler.hpp"
 
 using namespace Graphics;
 
@@ -83,6 +84,8 @@ Renderer::Renderer(SystemManager& system_manager)
 	system_manager.OnUpdate().connect<&Renderer::Render>(this);
 
 	m_entity_manager.on_construct<ShapeId>().connect<&Renderer::OnShapeCreated>(this);
+	m_shape_manager.OnShapeEdited().connect<&Renderer::OnShapeEdited>(this);
+	m_shape_manager.OnShapeDeleted().connect<&Renderer::OnShapeDeleted>(this);
 }
 
 Renderer::~Renderer() = default;
@@ -133,12 +136,28 @@ float Renderer::GetAspectRatio() const {
 
 void Renderer::OnShapeCreated(entt::registry& registry, entt::entity entity) {
 	ShapeId shape_id = registry.get<ShapeId>(entity);
+	// One texture for every entity sharing the shape
+	if (m_shape_texture_manager->IsTextureUploaded(shape_id)) {
+		return;
+	}
 	if (auto* shape = m_shape_manager.GetShape(shape_id)) {
 		m_shape_texture_manager->CreateTexture(shape_id, *shape);
 	}
 }
 
+void Renderer::OnShapeEdited(const ShapeEdit& edit) {
+	if (auto* shape = m_shape_manager.GetShape(edit.shape_id)) {
+		m_shape_texture_manager->UpdateTexture(edit.shape_id, *shape, edit.distances);
+	}
+}
+
+void Renderer::OnShapeDeleted(ShapeId shape_id) {
+	m_shape_texture_manager->DeleteTexture(shape_id);
+}
+
 void Renderer::Render(float dt) {
+	PROFILE_ZONE("Renderer::Render");
+
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	{
@@ -171,6 +190,7 @@ void Renderer::Render(float dt) {
 				auto rotation = transform.CalculateRotationMatrix();
 
 				m_object_shader.Uniform("u_mat_tex", 0);
+				m_object_shader.Uniform("u_distance_scale_bias", glm::vec2(texture->distance_scale, texture->distance_bias));
 				m_object_shader.Uniform("u_size", size);
 				m_object_shader.Uniform("u_corner", transform.position - rotation * shape->GetCenterOffset());
 				m_object_shader.Uniform("u_rotation", transform.rotation);
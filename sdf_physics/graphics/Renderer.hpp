@@ -6,11 +6,13 @@
 #include "Camera.hpp"
 #include "util/IntTypes.hpp"
 #include "ecs/EntityManager.hpp"
+#include "engine/shape/ShapeId.hpp"
 
 class Window;
 class SystemManager;
 class ShapeManager;
 class ShapeTextureManager;
+struct ShapeEdit;
 class DebugDrawing;
 
 namespace Graphics {
@@ -50,6 +52,8 @@ public:
 private:
 	void Initialize();
 	void OnShapeCreated(entt::registry&, entt::entity);
+	void OnShapeEdited(const ShapeEdit& edit);
+	void OnShapeDeleted(ShapeId shape_id);
 
 	void SetCameraUniforms(ShaderProgram& shader);
 	float GetAspectRatio() const;
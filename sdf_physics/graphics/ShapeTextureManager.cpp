@@ -4,6 +4,29 @@
 
 #include "engine/shape/Shape.hpp"
 
+namespace {
+
+struct TextureFormat {
+	GLenum internal_format;
+	GLenum type;
+	u32 element_size;
+	// Stored value that the texture reads as 1
+	float max_value;
+};
+
+TextureFormat GetTextureFormat(SdfFormat format) {
+	switch (format) {
+	case SdfFormat::Int16:
+		return { GL_R16_SNORM, GL_SHORT, sizeof(i16), 32767.f };
+	case SdfFormat::UInt8:
+		return { GL_R8, GL_UNSIGNED_BYTE, sizeof(u8), 255.f };
+	default:
+		return { GL_R32F, GL_FLOAT, sizeof(float), 1.f };
+	}
+}
+
+}
+
 void ShapeTexture::Bind(u32 slot) {
 	glActiveTexture(GL_TEXTURE0 + slot);
 	glBindTexture(GL_TEXTURE_2D, texture_id);
@@ -25,6 +48,19 @@ void ShapeTextureManager::CreateTexture(ShapeId id, const Shape& shape) {
 	auto& size = shape.GetSize();
 	texture.size = size;
 
+	// Dense sdfs are uploaded in their stored format and dequantized in the shader
+	auto& sdf = shape.GetSdf();
+	const void* data = sdf.GetDenseData();
+	auto format = GetTextureFormat(data ? sdf.GetFormat() : SdfFormat::Float32);
+	std::vector<float> distances;
+	if (data) {
+		texture.distance_scale = sdf.GetQuantizationScale() * format.max_value;
+		texture.distance_bias = sdf.GetQuantizationBias();
+	} else {
+		sdf.CopyDistances({ glm::uvec2(0), size }, distances);
+		data = distances.data();
+	}
+
 	//glTexImage2D(
 	//	GL_TEXTURE_2D,
 	//	0,
@@ -37,18 +73,20 @@ void ShapeTextureManager::CreateTexture(ShapeId id, const Shape& shape) {
 	//	shape.GetImage().data()
 	//);
 
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glTexImage2D(
 		GL_TEXTURE_2D,
 		0,
-		GL_R32F,
+		format.internal_format,
 		size.x,
 		size.y,
 		0,
 		GL_RED,
-		GL_FLOAT,
+		format.type,
 		//shape.GetImage().data()
-		shape.GetSdf().m_distances.data()
+		data
 	);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	// glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -57,6 +95,48 @@ void ShapeTextureManager::CreateTexture(ShapeId id, const Shape& shape) {
 	m_shape_textures.emplace(id, std::move(texture));
 }
 
+void ShapeTextureManager::UpdateTexture(ShapeId id, const Shape& shape, const PixelRect& rect) {
+	auto* texture = GetTexture(id);
+	if (!texture) {
+		return;
+	}
+	auto rect_size = rect.GetSize();
+
+	auto& sdf = shape.GetSdf();
+	auto* data = static_cast<const u8*>(sdf.GetDenseData());
+	auto format = GetTextureFormat(data ? sdf.GetFormat() : SdfFormat::Float32);
+	std::vector<float> distances;
+	u32 row_length = rect_size.x;
+	if (data) {
+		// Requantizing an edited sdf moves its range, the edit then covers the whole texture
+		texture->distance_scale = sdf.GetQuantizationScale() * format.max_value;
+		texture->distance_bias = sdf.GetQuantizationBias();
+		row_length = shape.GetSize().x;
+		data += format.element_size * (rect.min.x + rect.min.y * row_length);
+	} else {
+		sdf.CopyDistances(rect, distances);
+		data = reinterpret_cast<const u8*>(distances.data());
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture->texture_id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+	glTexSubImage2D(
+		GL_TEXTURE_2D,
+		0,
+		rect.min.x,
+		rect.min.y,
+		rect_size.x,
+		rect_size.y,
+		GL_RED,
+		format.type,
+		data
+	);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 ShapeTexture* ShapeTextureManager::GetTexture(ShapeId id) {
 	if (auto iter = m_shape_textures.find(id); iter != m_shape_textures.end()) {
 		return &iter->second;
@@ -66,7 +146,7 @@ ShapeTexture* ShapeTextureManager::GetTexture(ShapeId id) {
 
 void ShapeTextureManager::DeleteTexture(ShapeId id) {
 	if (auto iter = m_shape_textures.find(id); iter != m_shape_textures.end()) {
-		// remove texture in gl
+		glDeleteTextures(1, &iter->second.texture_id);
 		m_shape_textures.erase(iter);
 	}
 }
@@ -6,17 +6,23 @@
 #include "util/IntTypes.hpp"
 
 class Shape;
+struct PixelRect;
 
 struct ShapeTexture {
 	void Bind(u32 slot);
 
 	glm::uvec2 size;
 	u32 texture_id;
+	// Distance is the sampled value * distance_scale + distance_bias
+	float distance_scale = 1.f;
+	float distance_bias = 0.f;
 };
 
 class ShapeTextureManager {
 public:
 	void CreateTexture(ShapeId, const Shape& shape);
+	/// Uploads the distances inside rect again and refreshes the quantization scale and bias
+	void UpdateTexture(ShapeId, const Shape& shape, const PixelRect& rect);
 
 	ShapeTexture* GetTexture(ShapeId);
 
@@ -4,8 +4,14 @@ out vec4 out_frag_color;
 in vec2 texture_coords;
 
 uniform sampler2D u_mat_tex;
+// Quantized sdfs are dequantized with scale and bias
+uniform vec2 u_distance_scale_bias;
 uniform vec3 u_color;
 
+float distance_at(vec2 coords) {
+	return texture(u_mat_tex, coords).r * u_distance_scale_bias.x + u_distance_scale_bias.y;
+}
+
 vec3 permute(vec3 x) { return mod(((x*34.0)+1.0)*x, 289.0); }
 float snoise(vec2 v){
   const vec4 C = vec4(0.211324865405187, 0.366025403784439,
@@ -46,11 +52,11 @@ void main() {
 //	float color1 = mix(color01, color11, t.x);
 //	float color = mix(color0, color1, t.y);
 
-	float color00 = texture(u_mat_tex, texture_coords).r;
+	float color00 = distance_at(texture_coords);
 
 	vec3 pixel_size = vec3(1,1,0) / vec3(textureSize(u_mat_tex, 0), 1.0);
-	float color10 = texture(u_mat_tex, texture_coords + pixel_size.xz).r;
-	float color01 = texture(u_mat_tex, texture_coords + pixel_size.zy).r;
+	float color10 = distance_at(texture_coords + pixel_size.xz);
+	float color01 = distance_at(texture_coords + pixel_size.zy);
 	float dx = color10 - color00;
 	float dy = color01 - color00;
 	out_frag_color = vec4(0.01 * vec2(dx, dy) / pixel_size.xy, 0, 1.0);
@@ -0,0 +1,356 @@
+#include "AabbTree.hpp"
+
+#include <glm/common.hpp>
+
+namespace {
+
+Aabb Union(const Aabb& a, const Aabb& b) {
+	return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+bool Contains(const Aabb& outer, const Aabb& inner) {
+	return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+}
+
+bool Overlaps(const Aabb& a, const Aabb& b) {
+	return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+}
+
+float Perimeter(const Aabb& aabb) {
+	glm::vec2 size = aabb.max - aabb.min;
+	return 2.f * (size.x + size.y);
+}
+
+Aabb Grow(const Aabb& aabb, float margin) {
+	return { aabb.min - glm::vec2(margin), aabb.max + glm::vec2(margin) };
+}
+
+}
+
+AabbTree::AabbTree(float margin)
+	: m_margin{ margin }
+{}
+
+u32 AabbTree::Insert(const Aabb& aabb, u32 value) {
+	u32 leaf = AllocateNode();
+	auto& node = m_nodes[leaf];
+	node.aabb = Grow(aabb, m_margin);
+	node.height = 0;
+	node.value = value;
+	InsertLeaf(leaf);
+	++m_num_leaves;
+	return leaf;
+}
+
+void AabbTree::Remove(u32 leaf) {
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	--m_num_leaves;
+}
+
+bool AabbTree::Move(u32 leaf, const Aabb& aabb) {
+	auto& fat_aabb = m_nodes[leaf].aabb;
+	// Also reinserted when it shrank a lot, so the fattened aabb stays close
+	if (Contains(fat_aabb, aabb) && Contains(Grow(aabb, 4.f * m_margin), fat_aabb)) {
+		return false;
+	}
+	RemoveLeaf(leaf);
+	m_nodes[leaf].aabb = Grow(aabb, m_margin);
+	InsertLeaf(leaf);
+	return true;
+}
+
+u32 AabbTree::GetValue(u32 leaf) const {
+	return m_nodes[leaf].value;
+}
+
+const Aabb& AabbTree::GetFatAabb(u32 leaf) const {
+	return m_nodes[leaf].aabb;
+}
+
+u32 AabbTree::GetNumLeaves() const {
+	return m_num_leaves;
+}
+
+u32 AabbTree::GetHeight() const {
+	return m_root == c_NullNode ? 0 : static_cast<u32>(m_nodes[m_root].height);
+}
+
+void AabbTree::Query(const Aabb& aabb, std::vector<u32>& values) const {
+	if (m_root == c_NullNode) {
+		return;
+	}
+	m_stack.clear();
+	m_stack.push_back(m_root);
+	while (!m_stack.empty()) {
+		auto& node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+		if (!Overlaps(node.aabb, aabb)) {
+			continue;
+		}
+		if (node.IsLeaf()) {
+			values.push_back(node.value);
+		} else {
+			m_stack.push_back(node.child_a);
+			m_stack.push_back(node.child_b);
+		}
+	}
+}
+
+void AabbTree::QueryPairs(std::vector<std::pair<u32, u32>>& pairs) const {
+	if (m_root == c_NullNode) {
+		return;
+	}
+	m_pair_stack.clear();
+	m_pair_stack.push_back({ m_root, m_root });
+	while (!m_pair_stack.empty()) {
+		auto [a, b] = m_pair_stack.back();
+		m_pair_stack.pop_back();
+		auto& node_a = m_nodes[a];
+		auto& node_b = m_nodes[b];
+
+		// A subtree against itself, the pairs inside each child and between them
+		if (a == b) {
+			if (!node_a.IsLeaf()) {
+				m_pair_stack.push_back({ node_a.child_a, node_a.child_a });
+				m_pair_stack.push_back({ node_a.child_b, node_a.child_b });
+				m_pair_stack.push_back({ node_a.child_a, node_a.child_b });
+			}
+			continue;
+		}
+		if (!Overlaps(node_a.aabb, node_b.aabb)) {
+			continue;
+		}
+		if (node_a.IsLeaf() && node_b.IsLeaf()) {
+			pairs.push_back({ node_a.value, node_b.value });
+		} else if (node_b.IsLeaf() || (!node_a.IsLeaf() && Perimeter(node_a.aabb) > Perimeter(node_b.aabb))) {
+			m_pair_stack.push_back({ node_a.child_a, b });
+			m_pair_stack.push_back({ node_a.child_b, b });
+		} else {
+			m_pair_stack.push_back({ a, node_b.child_a });
+			m_pair_stack.push_back({ a, node_b.child_b });
+		}
+	}
+}
+
+void AabbTree::QueryPairs(const AabbTree& other, std::vector<std::pair<u32, u32>>& pairs) const {
+	if (m_root == c_NullNode || other.m_root == c_NullNode) {
+		return;
+	}
+	m_pair_stack.clear();
+	m_pair_stack.push_back({ m_root, other.m_root });
+	while (!m_pair_stack.empty()) {
+		auto [a, b] = m_pair_stack.back();
+		m_pair_stack.pop_back();
+		auto& node_a = m_nodes[a];
+		auto& node_b = other.m_nodes[b];
+		if (!Overlaps(node_a.aabb, node_b.aabb)) {
+			continue;
+		}
+		if (node_a.IsLeaf() && node_b.IsLeaf()) {
+			pairs.push_back({ node_a.value, node_b.value });
+		} else if (node_b.IsLeaf() || (!node_a.IsLeaf() && Perimeter(node_a.aabb) > Perimeter(node_b.aabb))) {
+			m_pair_stack.push_back({ node_a.child_a, b });
+			m_pair_stack.push_back({ node_a.child_b, b });
+		} else {
+			m_pair_stack.push_back({ a, node_b.child_a });
+			m_pair_stack.push_back({ a, node_b.child_b });
+		}
+	}
+}
+
+u32 AabbTree::AllocateNode() {
+	if (m_free_list == c_NullNode) {
+		m_nodes.emplace_back();
+		return static_cast<u32>(m_nodes.size() - 1);
+	}
+	u32 node = m_free_list;
+	m_free_list = m_nodes[node].parent;
+	m_nodes[node] = Node{};
+	return node;
+}
+
+void AabbTree::FreeNode(u32 node) {
+	m_nodes[node] = Node{};
+	m_nodes[node].parent = m_free_list;
+	m_free_list = node;
+}
+
+void AabbTree::InsertLeaf(u32 leaf) {
+	if (m_root == c_NullNode) {
+		m_root = leaf;
+		m_nodes[leaf].parent = c_NullNode;
+		return;
+	}
+
+	// Walks down to the sibling with the lowest perimeter cost, the surface area heuristic in 2d
+	const Aabb leaf_aabb = m_nodes[leaf].aabb;
+	u32 index = m_root;
+	while (!m_nodes[index].IsLeaf()) {
+		auto& node = m_nodes[index];
+		const float perimeter = Perimeter(node.aabb);
+		const float combined = Perimeter(Union(node.aabb, leaf_aabb));
+		// Cost of a new parent here, and the growth every deeper choice adds to this node
+		const float cost = 2.f * combined;
+		const float inheritance = 2.f * (combined - perimeter);
+
+		auto child_cost = [&](u32 child) {
+			auto& child_node = m_nodes[child];
+			float grown = Perimeter(Union(child_node.aabb, leaf_aabb));
+			return (child_node.IsLeaf() ? grown : grown - Perimeter(child_node.aabb)) + inheritance;
+		};
+		const float cost_a = child_cost(node.child_a);
+		const float cost_b = child_cost(node.child_b);
+		if (cost < cost_a && cost < cost_b) {
+			break;
+		}
+		index = cost_a < cost_b ? node.child_a : node.child_b;
+	}
+
+	const u32 sibling = index;
+	const u32 old_parent = m_nodes[sibling].parent;
+	const u32 new_parent = AllocateNode();
+	auto& parent = m_nodes[new_parent];
+	parent.parent = old_parent;
+	parent.aabb = Union(leaf_aabb, m_nodes[sibling].aabb);
+	parent.height = m_nodes[sibling].height + 1;
+	parent.child_a = sibling;
+	parent.child_b = leaf;
+	m_nodes[sibling].parent = new_parent;
+	m_nodes[leaf].parent = new_parent;
+
+	if (old_parent == c_NullNode) {
+		m_root = new_parent;
+	} else if (m_nodes[old_parent].child_a == sibling) {
+		m_nodes[old_parent].child_a = new_parent;
+	} else {
+		m_nodes[old_parent].child_b = new_parent;
+	}
+
+	Refit(m_nodes[leaf].parent);
+}
+
+void AabbTree::RemoveLeaf(u32 leaf) {
+	if (leaf == m_root) {
+		m_root = c_NullNode;
+		return;
+	}
+
+	const u32 parent = m_nodes[leaf].parent;
+	const u32 grand_parent = m_nodes[parent].parent;
+	const u32 sibling = m_nodes[parent].child_a == leaf ? m_nodes[parent].child_b : m_nodes[parent].child_a;
+
+	m_nodes[sibling].parent = grand_parent;
+	FreeNode(parent);
+	if (grand_parent == c_NullNode) {
+		m_root = sibling;
+		return;
+	}
+	if (m_nodes[grand_parent].child_a == parent) {
+		m_nodes[grand_parent].child_a = sibling;
+	} else {
+		m_nodes[grand_parent].child_b = sibling;
+	}
+	Refit(grand_parent);
+}
+
+void AabbTree::Refit(u32 node) {
+	while (node != c_NullNode) {
+		node = Balance(node);
+		auto& current = m_nodes[node];
+		auto& a = m_nodes[current.child_a];
+		auto& b = m_nodes[current.child_b];
+		current.height = 1 + glm::max(a.height, b.height);
+		current.aabb = Union(a.aabb, b.aabb);
+		node = current.parent;
+	}
+}
+
+u32 AabbTree::Balance(u32 index_a) {
+	auto& a = m_nodes[index_a];
+	if (a.IsLeaf() || a.height < 2) {
+		return index_a;
+	}
+
+	const u32 index_b = a.child_a;
+	const u32 index_c = a.child_b;
+	auto& b = m_nodes[index_b];
+	auto& c = m_nodes[index_c];
+	const i32 balance = c.height - b.height;
+
+	auto replace_in_parent = [this, index_a](u32 parent, u32 child) {
+		if (parent == c_NullNode) {
+			m_root = child;
+		} else if (m_nodes[parent].child_a == index_a) {
+			m_nodes[parent].child_a = child;
+		} else {
+			m_nodes[parent].child_b = child;
+		}
+	};
+
+	// Rotates c up, a keeps b and the lower of c's children
+	if (balance > 1) {
+		const u32 index_f = c.child_a;
+		const u32 index_g = c.child_b;
+		auto& f = m_nodes[index_f];
+		auto& g = m_nodes[index_g];
+
+		c.child_a = index_a;
+		c.parent = a.parent;
+		a.parent = index_c;
+		replace_in_parent(c.parent, index_c);
+
+		if (f.height > g.height) {
+			c.child_b = index_f;
+			a.child_b = index_g;
+			g.parent = index_a;
+			a.aabb = Union(b.aabb, g.aabb);
+			c.aabb = Union(a.aabb, f.aabb);
+			a.height = 1 + glm::max(b.height, g.height);
+			c.height = 1 + glm::max(a.height, f.height);
+		} else {
+			c.child_b = index_g;
+			a.child_b = index_f;
+			f.parent = index_a;
+			a.aabb = Union(b.aabb, f.aabb);
+			c.aabb = Union(a.aabb, g.aabb);
+			a.height = 1 + glm::max(b.height, f.height);
+			c.height = 1 + glm::max(a.height, g.height);
+		}
+		return index_c;
+	}
+
+	// Rotates b up, a keeps c and the lower of b's children
+	if (balance < -1) {
+		const u32 index_d = b.child_a;
+		const u32 index_e = b.child_b;
+		auto& d = m_nodes[index_d];
+		auto& e = m_nodes[index_e];
+
+		b.child_a = index_a;
+		b.parent = a.parent;
+		a.parent = index_b;
+		replace_in_parent(b.parent, index_b);
+
+		if (d.height > e.height) {
+			b.child_b = index_d;
+			a.child_a = index_e;
+			e.parent = index_a;
+			a.aabb = Union(c.aabb, e.aabb);
+			b.aabb = Union(a.aabb, d.aabb);
+			a.height = 1 + glm::max(c.height, e.height);
+			b.height = 1 + glm::max(a.height, d.height);
+		} else {
+			b.child_b = index_e;
+			a.child_a = index_d;
+			d.parent = index_a;
+			a.aabb = Union(c.aabb, d.aabb);
+			b.aabb = Union(a.aabb, e.aabb);
+			a.height = 1 + glm::max(c.height, d.height);
+			b.height = 1 + glm::max(a.height, e.height);
+		}
+		return index_b;
+	}
+
+	return index_a;
+}
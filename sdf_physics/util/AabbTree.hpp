@@ -0,0 +1,65 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+#include "Aabb.hpp"
+#include "IntTypes.hpp"
+
+/// Dynamic bounding volume tree. Leaves store their aabb grown by a margin, so a leaf is only
+/// reinserted when its bounds leave the fattened ones, and the ancestors of a reinserted leaf
+/// are refit and rebalanced with rotations on the way up.
+class AabbTree {
+public:
+	static constexpr u32 c_NullNode = ~0u;
+
+	explicit AabbTree(float margin = 0.f);
+
+	/// Returns the leaf, value is returned by the pair queries
+	u32 Insert(const Aabb& aabb, u32 value);
+	void Remove(u32 leaf);
+	/// Reinserts leaf if aabb is no longer inside its fattened aabb, returns true if it was
+	bool Move(u32 leaf, const Aabb& aabb);
+
+	u32 GetValue(u32 leaf) const;
+	const Aabb& GetFatAabb(u32 leaf) const;
+	u32 GetNumLeaves() const;
+	/// Longest path from the root to a leaf, 0 for a single leaf
+	u32 GetHeight() const;
+
+	/// Appends the values of the leaves whose fattened aabbs overlap aabb
+	void Query(const Aabb& aabb, std::vector<u32>& values) const;
+	/// Appends the values of every pair of leaves with overlapping fattened aabbs, each once
+	void QueryPairs(std::vector<std::pair<u32, u32>>& pairs) const;
+	/// Appends (value in this tree, value in other) for every pair of overlapping leaves
+	void QueryPairs(const AabbTree& other, std::vector<std::pair<u32, u32>>& pairs) const;
+private:
+	struct Node {
+		Aabb aabb;
+		u32 parent = c_NullNode;
+		u32 child_a = c_NullNode;
+		u32 child_b = c_NullNode;
+		/// 0 for leaves, -1 for free nodes
+		i32 height = -1;
+		u32 value = 0;
+
+		bool IsLeaf() const {
+			return child_a == c_NullNode;
+		}
+	};
+
+	u32 AllocateNode();
+	void FreeNode(u32 node);
+	void InsertLeaf(u32 leaf);
+	void RemoveLeaf(u32 leaf);
+	/// Refits and rebalances the ancestors of node up to the root
+	void Refit(u32 node);
+	u32 Balance(u32 node);
+
+	float m_margin;
+	std::vector<Node> m_nodes;
+	u32 m_root = c_NullNode;
+	u32 m_free_list = c_NullNode;
+	u32 m_num_leaves = 0;
+	mutable std::vector<std::pair<u32, u32>> m_pair_stack;
+	mutable std::vector<u32> m_stack;
+};
@@ -0,0 +1,92 @@
+#include "MappedFile.hpp"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::Open(const std::string& path) {
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER size{};
+	if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		std::cerr << "ERROR: could not open " << path << "\n";
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!data) {
+		std::cerr << "ERROR: could not map " << path << "\n";
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<const u8*>(data);
+	m_size = static_cast<u64>(size.QuadPart);
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	struct stat status {};
+	if (file < 0 || fstat(file, &status) != 0 || status.st_size == 0) {
+		std::cerr << "ERROR: could not open " << path << "\n";
+		if (file >= 0) {
+			close(file);
+		}
+		return false;
+	}
+	void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping keeps the file alive
+	close(file);
+	if (data == MAP_FAILED) {
+		std::cerr << "ERROR: could not map " << path << "\n";
+		return false;
+	}
+	m_data = static_cast<const u8*>(data);
+	m_size = static_cast<u64>(status.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::Close() {
+	if (!m_data) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	CloseHandle(m_file);
+	m_file = nullptr;
+	m_mapping = nullptr;
+#else
+	munmap(const_cast<u8*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+const u8* MappedFile::GetData() const {
+	return m_data;
+}
+
+u64 MappedFile::GetSize() const {
+	return m_size;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include "IntTypes.hpp"
+
+/// Read only view of a whole file mapped into memory, pages are loaded when first touched
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// Prints an error and returns false if the file can not be mapped
+	bool Open(const std::string& path);
+	void Close();
+
+	const u8* GetData() const;
+	u64 GetSize() const;
+private:
+	const u8* m_data = nullptr;
+	u64 m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
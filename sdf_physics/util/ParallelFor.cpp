@@ -0,0 +1,194 @@
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+thread_local bool t_inside_parallel_for = false;
+
+class WorkerPool {
+public:
+	WorkerPool() {
+		u32 num_threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+		for (u32 i = 0; i < num_threads; ++i) {
+			m_threads.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	~WorkerPool() {
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		for (auto& thread : m_threads) {
+			thread.join();
+		}
+	}
+
+	u32 GetNumThreads() const {
+		return static_cast<u32>(m_threads.size());
+	}
+
+	void Run(u32 count, u32 batch_size, const std::function<void(u32, u32)>& func) {
+		// One range at a time, concurrent callers wait for their turn
+		std::lock_guard run_lock(m_run_mutex);
+		{
+			std::lock_guard lock(m_mutex);
+			m_func = &func;
+			m_count = count;
+			m_batch_size = batch_size;
+			m_next_begin = 0;
+			m_num_active_workers = static_cast<u32>(m_threads.size());
+			++m_generation;
+		}
+		m_wake.notify_all();
+
+		ProcessBatches();
+
+		std::unique_lock lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_num_active_workers == 0; });
+		m_func = nullptr;
+	}
+
+private:
+	void WorkerLoop() {
+		t_inside_parallel_for = true;
+		u64 seen_generation = 0;
+		while (true) {
+			{
+				std::unique_lock lock(m_mutex);
+				m_wake.wait(lock, [&]() { return m_stopping || m_generation != seen_generation; });
+				if (m_stopping) {
+					return;
+				}
+				seen_generation = m_generation;
+			}
+
+			ProcessBatches();
+
+			{
+				std::lock_guard lock(m_mutex);
+				--m_num_active_workers;
+			}
+			m_done.notify_one();
+		}
+	}
+
+	void ProcessBatches() {
+		while (true) {
+			u32 begin = m_next_begin.fetch_add(m_batch_size);
+			if (begin >= m_count) {
+				return;
+			}
+			(*m_func)(begin, std::min(begin + m_batch_size, m_count));
+		}
+	}
+
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_run_mutex;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	bool m_stopping = false;
+	u64 m_generation = 0;
+	u32 m_num_active_workers = 0;
+
+	const std::function<void(u32, u32)>* m_func = nullptr;
+	u32 m_count = 0;
+	u32 m_batch_size = 1;
+	std::atomic<u32> m_next_begin = 0;
+};
+
+WorkerPool& GetWorkerPool() {
+	static WorkerPool pool;
+	return pool;
+}
+
+class BackgroundQueue {
+public:
+	BackgroundQueue() {
+		// At least one, unlike the worker pool the calling thread does not help
+		u32 num_threads = std::max(1u, std::max(1u, std::thread::hardware_concurrency()) - 1);
+		for (u32 i = 0; i < num_threads; ++i) {
+			m_threads.emplace_back([this]() { WorkerLoop(); });
+		}
+	}
+
+	~BackgroundQueue() {
+		{
+			std::lock_guard lock(m_mutex);
+			m_stopping = true;
+		}
+		m_wake.notify_all();
+		for (auto& thread : m_threads) {
+			thread.join();
+		}
+	}
+
+	void Push(std::function<void()> job) {
+		{
+			std::lock_guard lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_wake.notify_one();
+	}
+
+private:
+	void WorkerLoop() {
+		t_inside_parallel_for = true;
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock lock(m_mutex);
+				m_wake.wait(lock, [&]() { return m_stopping || !m_jobs.empty(); });
+				if (m_stopping) {
+					return;
+				}
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stopping = false;
+	std::deque<std::function<void()>> m_jobs;
+};
+
+}
+
+void ParallelFor(u32 count, u32 batch_size, const std::function<void(u32 begin, u32 end)>& func) {
+	batch_size = std::max(batch_size, 1u);
+	if (count == 0) {
+		return;
+	}
+	if (count <= batch_size || t_inside_parallel_for || GetWorkerPool().GetNumThreads() == 0) {
+		func(0, count);
+		return;
+	}
+
+	t_inside_parallel_for = true;
+	GetWorkerPool().Run(count, batch_size, func);
+	t_inside_parallel_for = false;
+}
+
+u32 GetNumWorkerThreads() {
+	return GetWorkerPool().GetNumThreads();
+}
+
+void RunInBackground(std::function<void()> job) {
+	static BackgroundQueue queue;
+	queue.Push(std::move(job));
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <functional>
+
+#include "IntTypes.hpp"
+
+/// Calls func(begin, end) for batches of [0, count) on the worker threads and the calling
+/// thread, returns when all batches are done. Runs inline when the range is a single batch
+/// or when called from inside another ParallelFor.
+void ParallelFor(u32 count, u32 batch_size, const std::function<void(u32 begin, u32 end)>& func);
+
+u32 GetNumWorkerThreads();
+
+/// Queues job for a background thread and returns right away. ParallelFor inside a job runs
+/// inline, so background work never holds up the ParallelFor calls of the frame.
+/// Jobs still queued when the program exits are dropped.
+void RunInBackground(std::function<void()> job);
@@ -0,0 +1,121 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct ZoneEvent {
+	std::string_view name;
+	Profiler::Clock::time_point start;
+	Profiler::Clock::time_point end;
+};
+
+struct ThreadBuffer {
+	u32 thread_index = 0;
+	std::atomic<u64> num_written = 0;
+	std::vector<ZoneEvent> events;
+};
+
+struct ProfilerState {
+	std::atomic_bool enabled = SDF_PHYSICS_PROFILER != 0;
+	Profiler::Clock::time_point start_time = Profiler::Clock::now();
+
+	// Buffers are owned here so they outlive the threads that wrote them
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+ProfilerState& GetState() {
+	static ProfilerState state;
+	return state;
+}
+
+ThreadBuffer& GetThreadBuffer() {
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (!buffer) {
+		auto& state = GetState();
+		std::lock_guard lock(state.mutex);
+		auto& added = state.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+		added->thread_index = static_cast<u32>(state.buffers.size() - 1);
+		added->events.resize(Profiler::c_RingBufferSize);
+		buffer = added.get();
+	}
+	return *buffer;
+}
+
+void WriteEscaped(std::ostream& out, std::string_view name) {
+	for (char c : name) {
+		if (c == '"' || c == '\\') {
+			out << '\\';
+		}
+		out << c;
+	}
+}
+
+}
+
+void Profiler::SetEnabled(bool enabled) {
+	GetState().enabled = enabled && SDF_PHYSICS_PROFILER;
+}
+
+bool Profiler::IsEnabled() {
+	return SDF_PHYSICS_PROFILER && GetState().enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::RecordZone(std::string_view name, Clock::time_point start, Clock::time_point end) {
+	if (!IsEnabled()) {
+		return;
+	}
+	auto& buffer = GetThreadBuffer();
+	u64 index = buffer.num_written.load(std::memory_order_relaxed);
+	buffer.events[index % c_RingBufferSize] = { name, start, end };
+	buffer.num_written.store(index + 1, std::memory_order_release);
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path) {
+	std::ofstream file(path);
+	if (!file) {
+		std::cerr << "ERROR: could not open " << path << " for writing\n";
+		return false;
+	}
+
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (auto& buffer : state.buffers) {
+		u64 num_written = buffer->num_written.load(std::memory_order_acquire);
+		u64 begin = num_written - std::min<u64>(num_written, c_RingBufferSize);
+		for (u64 i = begin; i < num_written; ++i) {
+			auto& event = buffer->events[i % c_RingBufferSize];
+			double start = std::chrono::duration<double, std::micro>(event.start - state.start_time).count();
+			double duration = std::chrono::duration<double, std::micro>(event.end - event.start).count();
+
+			file << (first ? "" : ",\n") << "{\"name\":\"";
+			WriteEscaped(file, event.name);
+			file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->thread_index
+				<< ",\"ts\":" << start << ",\"dur\":" << duration << "}";
+			first = false;
+		}
+	}
+	file << "\n]}\n";
+
+	return static_cast<bool>(file);
+}
+
+void Profiler::Clear() {
+	auto& state = GetState();
+	std::lock_guard lock(state.mutex);
+	for (auto& buffer : state.buffers) {
+		buffer->num_written.store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include "IntTypes.hpp"
+
+// Set to 0 to compile out all PROFILE_ZONE scopes
+#ifndef SDF_PHYSICS_PROFILER
+#define SDF_PHYSICS_PROFILER 1
+#endif
+
+/// Scoped zone profiler. Every thread records into its own ring buffer, the
+/// newest zones of all threads can be written as a Chrome trace (chrome://tracing).
+namespace Profiler {
+
+using Clock = std::chrono::steady_clock;
+
+/// Zones recorded per thread before the oldest are overwritten
+constexpr u32 c_RingBufferSize = 1 << 16;
+
+void SetEnabled(bool enabled);
+bool IsEnabled();
+
+/// name must outlive the profiler, string literals or entt type names
+void RecordZone(std::string_view name, Clock::time_point start, Clock::time_point end);
+
+/// Not synchronized with recording threads, call it between frames
+bool WriteChromeTrace(const std::string& path);
+void Clear();
+
+class ScopedZone {
+public:
+	ScopedZone(std::string_view name) : m_name{ name } {
+		if (IsEnabled()) {
+			m_start = Clock::now();
+			m_active = true;
+		}
+	}
+	~ScopedZone() {
+		if (m_active) {
+			RecordZone(m_name, m_start, Clock::now());
+		}
+	}
+	ScopedZone(const ScopedZone&) = delete;
+	ScopedZone& operator=(const ScopedZone&) = delete;
+private:
+	std::string_view m_name;
+	Clock::time_point m_start;
+	bool m_active = false;
+};
+
+}
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#if SDF_PHYSICS_PROFILER
+#define PROFILE_ZONE(name) Profiler::ScopedZone PROFILE_CONCAT(profile_zone_, __LINE__){ name }
+#else
+#define PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,103 @@
+#include "RadixSort.hpp"
+
+#include <algorithm>
+#include <array>
+#include "ParallelFor.hpp"
+
+namespace {
+
+constexpr u32 c_DigitBits = 8;
+constexpr u32 c_NumBuckets = 1 << c_DigitBits;
+constexpr u32 c_NumDigits = 64 / c_DigitBits;
+/// Below this std::sort wins over the extra passes
+constexpr u32 c_MinRadixCount = 1 << 11;
+/// Smallest block worth its own histogram
+constexpr u32 c_MinBlockSize = 1 << 13;
+
+u32 GetDigit(u64 key, u32 digit) {
+	return static_cast<u32>(key >> (digit * c_DigitBits)) & (c_NumBuckets - 1);
+}
+
+}
+
+void RadixSort(std::vector<u64>& keys, std::vector<u64>& scratch) {
+	const u32 count = static_cast<u32>(keys.size());
+	if (count < c_MinRadixCount) {
+		std::sort(keys.begin(), keys.end());
+		return;
+	}
+
+	// Fixed blocks keep the sort stable however the batches are spread over the threads
+	const u32 num_blocks = std::clamp(count / c_MinBlockSize, 1u, GetNumWorkerThreads() + 1);
+	const u32 block_size = (count + num_blocks - 1) / num_blocks;
+	auto block_begin = [&](u32 block) {
+		return std::min(block * block_size, count);
+	};
+
+	// Only bytes with bits set in some keys but not in all need a pass
+	std::vector<u64> block_or(num_blocks, 0);
+	std::vector<u64> block_and(num_blocks, ~u64(0));
+	ParallelFor(num_blocks, 1, [&](u32 begin, u32 end) {
+		for (u32 block = begin; block < end; ++block) {
+			u64 bits_or = 0;
+			u64 bits_and = ~u64(0);
+			for (u32 i = block_begin(block); i < block_begin(block + 1); ++i) {
+				bits_or |= keys[i];
+				bits_and &= keys[i];
+			}
+			block_or[block] = bits_or;
+			block_and[block] = bits_and;
+		}
+	});
+	u64 bits_or = 0;
+	u64 bits_and = ~u64(0);
+	for (u32 block = 0; block < num_blocks; ++block) {
+		bits_or |= block_or[block];
+		bits_and &= block_and[block];
+	}
+	const u64 differing_bits = bits_or ^ bits_and;
+
+	scratch.resize(count);
+	u64* source = keys.data();
+	u64* dest = scratch.data();
+	std::vector<std::array<u32, c_NumBuckets>> offsets(num_blocks);
+	for (u32 digit = 0; digit < c_NumDigits; ++digit) {
+		if (GetDigit(differing_bits, digit) == 0) {
+			continue;
+		}
+
+		ParallelFor(num_blocks, 1, [&](u32 begin, u32 end) {
+			for (u32 block = begin; block < end; ++block) {
+				auto& histogram = offsets[block];
+				histogram.fill(0);
+				for (u32 i = block_begin(block); i < block_begin(block + 1); ++i) {
+					++histogram[GetDigit(source[i], digit)];
+				}
+			}
+		});
+
+		// Bucket by bucket, and block by block within a bucket
+		u32 offset = 0;
+		for (u32 bucket = 0; bucket < c_NumBuckets; ++bucket) {
+			for (u32 block = 0; block < num_blocks; ++block) {
+				const u32 bucket_count = offsets[block][bucket];
+				offsets[block][bucket] = offset;
+				offset += bucket_count;
+			}
+		}
+
+		ParallelFor(num_blocks, 1, [&](u32 begin, u32 end) {
+			for (u32 block = begin; block < end; ++block) {
+				auto& block_offsets = offsets[block];
+				for (u32 i = block_begin(block); i < block_begin(block + 1); ++i) {
+					dest[block_offsets[GetDigit(source[i], digit)]++] = source[i];
+				}
+			}
+		});
+		std::swap(source, dest);
+	}
+
+	if (source != keys.data()) {
+		keys.swap(scratch);
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <vector>
+#include "IntTypes.hpp"
+
+/// Sorts keys ascending with least significant byte first passes, split into blocks on the
+/// ParallelFor workers. Bytes every key shares are skipped, so keys using few bits need few
+/// passes. Small inputs fall back to std::sort. scratch is resized and keeps its capacity.
+void RadixSort(std::vector<u64>& keys, std::vector<u64>& scratch);